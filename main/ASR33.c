@@ -3,8 +3,13 @@
 
 #include "revk.h"
 #include <driver/gpio.h>
+#include "esp_vfs_eventfd.h"
 #include "softuart.h"
 #include "tty.h"
+#include "ttys.h"
+#include "monitor.h"
+#include "telnet.h"
+#include "tcpline.h"
 #include "adventesp.h"
 
 #define	NUL	0
@@ -21,6 +26,7 @@
 #define	RO	0x7F
 
 #define	MAXRX	256             // Line max
+#define	MAXTCP	256             // TCP send and recv block max
 
 struct
 {
@@ -33,6 +39,11 @@ struct
    uint8_t dobig:1;             // Do big lettering on tape
    uint8_t docave:1;            // Run advent()
    uint8_t suppress:1;          // Suppress WRU
+   uint8_t dobist:1;            // Run loopback self test
+   uint8_t bistinternal:1;      // Self test by internal loopback (tx pad read back), not the external loop
+   uint8_t biststress:1;        // Self test at 2x and 4x baud as well
+   uint8_t dolease:1;           // Hand TCP lease to a monitor
+   uint8_t tcptelnet:1;         // TCP connection is telnet
 } b = { 0 };
 
 volatile int8_t power = 0;      // power request, -1 means want off, 1 means want on, 2 means want on with long timeout
@@ -44,6 +55,15 @@ int64_t lastrx = 0;             // Last rx
 int64_t done = 0;               // When to turn off
 uint32_t rxp = 0;               // Rx line buffer pointer
 uint8_t hayes = 0;              // Hayes +++ counter
+uint32_t bistbytes = 0;         // Self test bytes per rate, 0 for about 5 seconds
+int efd = -1;                   // Event fd to wake the main loop
+uint8_t tcptx[MAXTCP];          // Rx bytes gathered to send by TCP
+int tcptxn = 0;                 // Bytes in tcptx
+int64_t tcptxt = 0;             // When first byte in tcptx arrived
+TaskHandle_t waketask = NULL;   // Task notified by ints, to write efd
+volatile uint8_t bisting = 0;   // Self test task running, the main loop leaves the main line alone
+uint8_t leaseto = 0;            // Monitor to hand lease to, 0 for the first
+telnet_t tn;                    // Telnet state for TCP connection
 
 volatile uint8_t rxws[64];      // rx for ws
 volatile uint8_t rxwsp = 0;     // tx for ws
@@ -56,16 +76,81 @@ const unsigned char small_f[256][5] = {
 };
 
 void
-sendbyte (uint8_t b)
+sendbyte (uint8_t c)
 {
-   tty_tx (b);
-   b &= 0x7F;
-   if (b == CR)
+   tty_tx (c);
+   c &= 0x7F;
+   if (c == CR)
       pos = 0;
-   else if (b >= ' ' && b < RO)
+   else if (c >= ' ' && c < RO)
       pos++;
 }
 
+static void
+sendpos (const uint8_t * buf, int len)
+{                               // Track carriage position for a block being sent
+   for (int i = 0; i < len; i++)
+   {
+      uint8_t b = (buf[i] & 0x7F);
+      if (b == CR)
+         pos = 0;
+      else if (b >= ' ' && b < RO)
+         pos++;
+   }
+}
+
+void
+sendbuf (const uint8_t * buf, int len)
+{                               // Send a block of raw bytes in one go (not ITA2 translated)
+   sendpos (buf, len);
+   tty_tx_raw (buf, len, 1);
+}
+
+void
+sendblock (const uint8_t * buf, int len)
+{                               // Send a block of bytes in one go (ITA2 translated if set)
+   sendpos (buf, len);
+   tty_tx_buf (buf, len, 1);
+}
+
+static void
+sendecho (uint8_t c)
+{                               // Echo a typed byte, ahead of queued tx
+   tty_tx_pri (c);
+   sendpos (&c, 1);
+}
+
+static void
+tcpflush (void)
+{                               // Send rx bytes gathered for TCP, not blocking, closed if that fails
+   if (tcptxn && csock >= 0)
+   {
+      int l;
+      if (b.tcptelnet)
+      {                         // IAC doubled
+         uint8_t buf[MAXTCP * 2];
+         l = tcp_send (csock, buf, telnet_escape (&tn, tcptx, tcptxn, buf));
+      } else
+         l = tcp_send (csock, tcptx, tcptxn);
+      if (l < 0)
+      {
+         close (csock);
+         csock = -1;
+         jo_t j = jo_object_alloc ();
+         jo_string (j, "reason", "error");
+         revk_event ("closed", &j);
+      }
+   }
+   tcptxn = 0;
+}
+
+void
+sendnul (int n)
+{                               // Send a number of NULs, e.g. tape lead/tail
+   if (n > 0)
+      tty_tx_rep (NUL, n);
+}
+
 void
 cr (void)
 {                               // Do a carriage return
@@ -167,7 +252,7 @@ queuebig (int c)
    while (l--)
    {
       uint8_t c = *d++;
-      sendbyte (c);
+      sendbuf (&c, 1);
       c &= 0x7f;
       if (!nodc4 && c == DC4)
          sendbyte (DC2);
@@ -190,7 +275,10 @@ reportstate (void)
    jo_bool (j, "brk", b.brk);
    jo_bool (j, "busy", b.busy);
    if (port)
+   {
       jo_bool (j, "connected", csock >= 0);
+      jo_int (j, "monitors", monitor_count ());
+   }
    revk_state (NULL, &j);
 }
 
@@ -254,30 +342,144 @@ power_on (void)
    done = esp_timer_get_time () + 1000 * (power > 1 ? timekeyidle : timeremidle);
 }
 
+jo_t
+jo_uartstats (softuart_stats_t * s, uint16_t setbaud)
+{                               // Soft UART stats, for the main line or an extra line
+   jo_t j = jo_object_alloc ();
+   jo_int (j, "tx", s->tx);
+   jo_int (j, "rx", s->rx);
+   jo_int (j, "rxbadstart", s->rxbadstart);
+   jo_int (j, "rxbadstop", s->rxbadstop);
+   jo_int (j, "rxbad0", s->rxbad0);
+   jo_int (j, "rxbadish0", s->rxbadish0);
+   jo_int (j, "rxbad1", s->rxbad1);
+   jo_int (j, "rxbadish1", s->rxbadish1);
+   jo_int (j, "rxbadp", s->rxbadp);
+   jo_int (j, "rxoverrun", s->rxoverrun);
+   jo_int (j, "txhigh", s->txhigh);
+   jo_int (j, "rxhigh", s->rxhigh);
+   if (rxedge)
+   {
+      jo_int (j, "rxedgelost", s->rxedgelost);
+      if (s->rxbaudx100)
+         jo_litf (j, "rxbaud", "%u.%02u", s->rxbaudx100 / 100, s->rxbaudx100 % 100);      // As tracked from the sender
+      if (s->meter)
+      {                         // Teletype speed and distortion meter, averages, % (positive speed is fast, positive bias is marks long)
+         jo_object (j, "meter");
+         jo_int (j, "chars", s->meter);
+         jo_litf (j, "speed", "%s%u.%02u", s->speed < 0 ? "-" : "", abs (s->speed) / 100, abs (s->speed) % 100);
+         jo_litf (j, "bias", "%s%u.%02u", s->bias < 0 ? "-" : "", abs (s->bias) / 100, abs (s->bias) % 100);
+         jo_litf (j, "peak", "%u.%02u", s->peak / 100, s->peak % 100);
+         jo_litf (j, "stop", "%u.%02u", s->stop / 100, s->stop % 100);   // Bits
+         jo_close (j);
+      }
+   }
+   if (s->baudx100 != setbaud)
+      jo_litf (j, "baud", "%u.%02u", s->baudx100 / 100, s->baudx100 % 100);       // From auto-baud
+   return j;
+}
+
 jo_t
 jo_stats (char clear)
 {
    softuart_stats_t s;
    tty_stats (&s, clear);
-   jo_t j = jo_object_alloc ();
-   jo_int (j, "tx", s.tx);
-   jo_int (j, "rx", s.rx);
-   jo_int (j, "rxbadstart", s.rxbadstart);
-   jo_int (j, "rxbadstop", s.rxbadstop);
-   jo_int (j, "rxbad0", s.rxbad0);
-   jo_int (j, "rxbadish0", s.rxbadish0);
-   jo_int (j, "rxbad1", s.rxbad1);
-   jo_int (j, "rxbadish1", s.rxbadish1);
-   jo_int (j, "rxbadp", s.rxbadp);
+   jo_t j = jo_uartstats (&s, baud);
    jo_bool (j, "rxlevel", revk_gpio_get (rx));
    return j;
 }
 
-const char *
-app_callback (int client, const char *prefix, const char *target, const char *suffix, jo_t j)
+static void
+wake (void)
+{                               // Wake the main loop, not from an int
+   uint64_t one = 1;
+   if (efd >= 0)
+      write (efd, &one, sizeof (one));
+}
+
+static void
+bist_task (void *arg)
+{                               // Loopback self test at the baud rate in use, and at 2x and 4x to stress the timing, reported as info
+   uint16_t baudx100;
+   tty_get_format (&baudx100, NULL, NULL);      // The baud rate in use, which may be from auto-baud
+   char pass = 1;
+   jo_t j = jo_object_alloc ();
+   jo_bool (j, "internal", b.bistinternal);
+   jo_array (j, "runs");
+   for (int m = 1; m <= (b.biststress ? 4 : 1); m *= 2)
+   {
+      uint32_t rate = (uint32_t) baudx100 * m;
+      if (rate > 65535)
+         break;                 // Baud x100 is 16 bits
+      uint32_t bytes = bistbytes ? : rate / 200 ? : 1;      // About 5 seconds
+      softuart_bist_t r;
+      if (tty_bist (rate, bytes, b.bistinternal, &r))
+      {
+         pass = 0;
+         break;
+      }
+      uint32_t framing = r.stats.rxbadstart + r.stats.rxbadstop;
+      if (r.rx != r.tx || r.biterr || r.slips || framing)
+         pass = 0;
+      jo_object (j, NULL);
+      jo_litf (j, "baud", "%u.%02u", rate / 100, rate % 100);
+      jo_int (j, "tx", r.tx);
+      jo_int (j, "rx", r.rx);
+      jo_int (j, "bits", r.bits);
+      jo_int (j, "biterr", r.biterr);
+      if (r.bits)
+         jo_litf (j, "ber", "%.1e", (double) r.biterr / r.bits);
+      jo_int (j, "slips", r.slips);
+      jo_int (j, "framing", framing);
+      jo_int (j, "marginal", r.stats.rxbadish0 + r.stats.rxbadish1);        // Bits with samples not all the same
+      if (r.stats.meter)
+      {                         // Timing margin (% of a bit), half a bit less the worst edge error, and the bias in that
+         int margin = 5000 - r.stats.peak;
+         jo_litf (j, "margin", "%s%u.%02u", margin < 0 ? "-" : "", abs (margin) / 100, abs (margin) % 100);
+         jo_litf (j, "bias", "%s%u.%02u", r.stats.bias < 0 ? "-" : "", abs (r.stats.bias) / 100, abs (r.stats.bias) % 100);
+      }
+      if (r.brk)
+         jo_bool (j, "break", 1);
+      jo_int (j, "ms", r.us / 1000);
+      jo_close (j);
+      if (!r.rx)
+         break;                 // No loop, so no point stressing it
+   }
+   jo_close (j);
+   jo_bool (j, "pass", pass);
+   revk_info ("bist", &j);
+   bisting = 0;
+   wake ();
+   vTaskDelete (NULL);
+}
+
+static void
+wake_task (void *arg)
+{                               // Soft UART and RUN button ints notify this, as eventfd write is not safe from an IRAM int
+   while (1)
+   {
+      ulTaskNotifyTake (pdTRUE, portMAX_DELAY);
+      wake ();
+   }
+}
+
+static void IRAM_ATTR
+run_isr (void *arg)
+{                               // RUN button edge
+   BaseType_t woken = pdFALSE;
+   vTaskNotifyGiveFromISR (waketask, &woken);
+   if (woken == pdTRUE)
+      portYIELD_FROM_ISR ();
+}
+
+static const char *
+app_command (int client, const char *prefix, const char *target, const char *suffix, jo_t j)
 {
    if (client || target || !prefix || strcmp (prefix, "command"))
       return NULL;              // Not what we want
+   const char *e = ttys_command (suffix, j);
+   if (e)
+      return e;                 // Extra line
    if (!strcmp (suffix, "status"))
       reportstate ();
    if (!strcmp (suffix, "connect"))
@@ -288,6 +490,8 @@ app_callback (int client, const char *prefix, const char *target, const char *su
          revk_mqtt_send_raw (mtrtopic, 0, b.on ? "1" : "0", 0);
       reportstate ();
    }
+   if (bisting)
+      return "Self test running";       // Leave the line alone until done
    if (!strcmp (suffix, "restart"))
       power = -1;
    if (!strcmp (suffix, "cave"))
@@ -313,6 +517,31 @@ app_callback (int client, const char *prefix, const char *target, const char *su
       jo_t j = jo_stats (1);
       revk_info ("uartstats", &j);
    }
+   if (!strcmp (suffix, "bist"))
+   {                            // Loopback self test, once idle, optional {"bytes":N,"internal":true,"stress":false}
+      bistbytes = 0;
+      b.bistinternal = 0;
+      b.biststress = 1;
+      if (j && jo_here (j) == JO_OBJECT)
+      {
+         if (jo_find (j, "bytes") == JO_NUMBER)
+            bistbytes = jo_read_int (j);
+         if (jo_find (j, "internal") == JO_TRUE)
+            b.bistinternal = 1;
+         if (jo_find (j, "stress") == JO_FALSE)
+            b.biststress = 0;
+      }
+      if (csock >= 0 || monitor_count ())
+         return "Not while TCP connected";
+      b.dobist = 1;
+   }
+   if (!strcmp (suffix, "lease"))
+   {                            // Hand TCP lease to a monitor, optional monitor number
+      leaseto = 0;
+      if (j && jo_here (j) == JO_NUMBER)
+         leaseto = jo_read_int (j);
+      b.dolease = 1;
+   }
 
    if (!strcmp (suffix, "tape") || !strcmp (suffix, "taperaw") || !strcmp (suffix, "text") || !strcmp (suffix, "line")
        || !strcmp (suffix, "bell"))
@@ -331,12 +560,10 @@ app_callback (int client, const char *prefix, const char *target, const char *su
          {
             if (!nodc4)
                sendbyte (DC2);  // Tape on
-            for (int i = 0; i < tapelead; i++)
-               sendbyte (NUL);
+            sendnul (tapelead);
          }
          if (!strcmp (suffix, "taperaw"))
-            while (len--)
-               sendbyte (*value++);     // Raw
+            sendbuf ((uint8_t *) value, len);   // Raw
          else                   // Large text
             while (len--)
             {
@@ -347,8 +574,7 @@ app_callback (int client, const char *prefix, const char *target, const char *su
             }
          if (!suffix[4])
          {
-            for (int i = 0; i < tapetail; i++)
-               sendbyte (NUL);
+            sendnul (tapetail);
             if (!nodc4)
                sendbyte (DC4);  // Tape off
          }
@@ -383,8 +609,7 @@ app_callback (int client, const char *prefix, const char *target, const char *su
       if (!strcmp (suffix, "tx") || !strcmp (suffix, "txraw") || !strcmp (suffix, "raw"))
       {                         // raw send
          power = 1;
-         while (len--)
-            sendbyte (*value++);
+         sendbuf ((uint8_t *) value, len);
       }
       if (!strcmp (suffix, "punch") || !strcmp (suffix, "punchraw"))
       {                         // Raw punched data (with DC2/DC4)
@@ -392,14 +617,22 @@ app_callback (int client, const char *prefix, const char *target, const char *su
          if (!nodc4)
             sendbyte (DC2);     // Tape on
          if (!suffix[5])
+            sendnul (tapelead);
+         while (len > 0)
          {
-            for (int i = 0; i < tapelead; i++)
-               sendbyte (NUL);
-         }
-         while (len--)
-         {
+            int n = 0;
+            while (n < len && (value[n] & 0x7F) != DC4 && (value[n] & 0x7F) != WRU)
+               n++;
+            if (n)
+            {                   // Span of plain data
+               sendbuf ((uint8_t *) value, n);
+               value += n;
+               len -= n;
+               continue;
+            }
+            len--;
             uint8_t c = *value++;
-            sendbyte (c);
+            sendbuf (&c, 1);
             c &= 0x7f;
             if (!nodc4 && c == DC4)
                sendbyte (DC2);  // Turn tape back on
@@ -410,10 +643,7 @@ app_callback (int client, const char *prefix, const char *target, const char *su
             }
          }
          if (!suffix[5])
-         {
-            for (int i = 0; i < tapetail; i++)
-               sendbyte (NUL);
-         }
+            sendnul (tapetail);
          if (!nodc4)
          {
             sendbyte (DC4);     // Tape off
@@ -425,36 +655,41 @@ app_callback (int client, const char *prefix, const char *target, const char *su
    return "";
 }
 
+const char *
+app_callback (int client, const char *prefix, const char *target, const char *suffix, jo_t j)
+{                               // Commands set things for the main loop to do, so wake it
+   const char *e = app_command (client, prefix, target, suffix, j);
+   wake ();
+   return e;
+}
+
 void
 asr33_main (void *param)
 {
    b.doecho = !noecho;
 
    tty_setup ();
+   ttys_setup ();
+   monitor_setup ();
+   tty_tx_tap (monitor_add);    // Monitors see all tx, whatever sent it
+   esp_vfs_eventfd_config_t config = ESP_VFS_EVENTD_CONFIG_DEFAULT ();
+   esp_vfs_eventfd_register (&config);
+   efd = eventfd (0, 0);
+   xTaskCreate (wake_task, "wake", 2 * 1024, NULL, 5, &waketask);
+   tty_notify (waketask);
+   ttys_notify (waketask);
 
    revk_gpio_input (run);
+   if (run.set)
+   {
+      gpio_install_isr_service (ESP_INTR_FLAG_IRAM);    // May already be installed
+      gpio_set_intr_type (run.num, GPIO_INTR_ANYEDGE);
+      gpio_isr_handler_add (run.num, run_isr, NULL);
+   }
    revk_gpio_output (pwr, 0);
    revk_gpio_output (mtr, 0);
    if (port)
-      lsock = socket (AF_INET6, SOCK_STREAM, 0);        // IPPROTO_IPV6);
-   if (lsock >= 0)
-   {
-      struct sockaddr_storage dest_addr;
-      struct sockaddr_in6 *dest_addr_ip6 = (struct sockaddr_in6 *) &dest_addr;
-      bzero (&dest_addr_ip6->sin6_addr.un, sizeof (dest_addr_ip6->sin6_addr.un));
-      dest_addr_ip6->sin6_family = AF_INET6;
-      dest_addr_ip6->sin6_port = htons (port);
-      if (bind (lsock, (struct sockaddr *) &dest_addr, sizeof (dest_addr)))
-      {
-         close (lsock);
-         lsock = -1;
-      }
-   }
-   if (lsock >= 0 && listen (lsock, 1))
-   {
-      close (lsock);
-      lsock = -1;
-   }
+      lsock = tcp_listen (port, 1 + MONITORS);
    if (pwr.set)
       tty_xoff ();
    else
@@ -463,38 +698,19 @@ asr33_main (void *param)
    {
       if (csock >= 0)
          return;
-      const struct addrinfo hints = {
-         .ai_family = AF_UNSPEC,
-         .ai_socktype = SOCK_STREAM,
-         .ai_flags = AI_CANONNAME,
-      };
-      char ports[20];
-      sprintf (ports, "%d", port);
-      struct addrinfo *res = NULL,
-         *a;
-      int err = getaddrinfo (line, ports, &hints, &res);
-      if (err || !res)
+      char target[100];
+      int s = tcp_connect (line, port, target, sizeof (target));
+      if (s == -2)
          sendstring ("+++ HOST NAME NOT FOUND +++\n");
-      else
+      else if (s >= 0)
       {
-         for (a = res; a; a = a->ai_next)
-         {
-            int s = socket (a->ai_family, a->ai_socktype, a->ai_protocol);
-            if (s >= 0)
-            {
-               if (!connect (s, a->ai_addr, a->ai_addrlen))
-               {
-                  csock = s;
-                  jo_t j = jo_object_alloc ();
-                  if (res && res->ai_canonname)
-                     jo_string (j, "target", res->ai_canonname);
-                  revk_event ("connect", &j);
-                  break;
-               }
-               close (s);
-            }
-         }
-         freeaddrinfo (res);
+         csock = s;
+         tcptxn = 0;
+         b.tcptelnet = 0;       // Outgoing is raw
+         jo_t j = jo_object_alloc ();
+         if (*target)
+            jo_string (j, "target", target);
+         revk_event ("connect", &j);
       }
    }
    if (revk_gpio_get (run))
@@ -514,12 +730,58 @@ asr33_main (void *param)
    }
    if (autoon)
       dorun ();
+   int64_t next = 0;            // When the loop next needs to run (us), if nothing wakes it first
+   const int txsize = tty_tx_size ();   // Actual tx ring, txbuf may be 0 for the default
+   const int tcpspace = (txsize < 2 ? 1 : txsize / 2 < MAXTCP ? txsize / 2 : MAXTCP);  // Tx space needed to read from TCP, not 0 as a 0 recv looks like close
+   void due (int64_t when)
+   {
+      if (when < next)
+         next = when;
+   }
    while (1)
    {
-      usleep (10000);
+      {                         // Wait for a socket, the wake event fd (tty, RUN button, command), or next
+         fd_set r,
+           w;
+         FD_ZERO (&r);
+         FD_ZERO (&w);
+         int max = lsock;
+         if (lsock >= 0 && !bisting)
+            FD_SET (lsock, &r); // Connections wait while self test running
+         if (csock >= 0 && tty_tx_space () >= tcpspace)
+         {
+            FD_SET (csock, &r);
+            if (csock > max)
+               max = csock;
+         } else if (csock >= 0)
+            tty_tx_notify (tcpspace);   // Leave TCP in the socket, so its window closes, until tx has space
+         if (efd >= 0)
+            FD_SET (efd, &r);
+         if (efd > max)
+            max = efd;
+         max = ttys_fds (&r, max);
+         max = monitor_fds (&r, &w, max);
+         int64_t us = next - esp_timer_get_time ();
+         if (us < 0)
+            us = 0;
+         struct timeval timeout = {.tv_sec = us / 1000000,.tv_usec = us % 1000000 };
+         if (select (max + 1, &r, &w, NULL, &timeout) > 0 && efd >= 0 && FD_ISSET (efd, &r))
+         {
+            uint64_t n;
+            read (efd, &n, sizeof (n));
+         }
+      }
       int64_t now = esp_timer_get_time ();
+      next = now + 1000000;     // Even with nothing to do, in case
+      if (efd < 0)
+         next = now + 10000;    // Polling
+      int64_t tnext = ttys_poll ();
+      if (tnext)
+         due (tnext);
       int64_t gap = now - lastrx;
-      if (csock >= 0)
+      if (bisting)
+         revk_blink (1, 0, "Y");
+      else if (csock >= 0)
          revk_blink (1, 0, tty_tx_waiting ()? "CR" : "C");
       else if (hayes > 3)
          revk_blink (1, 0, "M");
@@ -533,10 +795,13 @@ asr33_main (void *param)
          if (!b.pressed)
          {                      // Button pressed
             b.pressed = 1;
-            if (b.on)
-               power = -1;      // Turn off
-            else
-               dorun ();
+            if (!bisting)
+            {                   // Does nothing while self test running
+               if (b.on)
+                  power = -1;   // Turn off
+               else
+                  dorun ();
+            }
          }
       } else
          b.pressed = 0;
@@ -561,7 +826,7 @@ asr33_main (void *param)
             power_on ();
       }
       // Check tx buffer usage
-      if (tty_tx_space () < 4096)
+      if (tty_tx_space () < txsize / 8)
       {
          if (!b.busy)
          {
@@ -577,31 +842,73 @@ asr33_main (void *param)
          }
       }
       // Handle incoming connection
-      if (lsock >= 0 && csock < 0)
-      {                         // Allow for connection
+      if (lsock >= 0 && !bisting)
+      {                         // Allow for connection, as a monitor if already connected
          fd_set s;
          FD_ZERO (&s);
          FD_SET (lsock, &s);
          struct timeval timeout = { };
          if (select (lsock + 1, &s, NULL, NULL, &timeout) > 0)
          {
-            struct sockaddr_storage source_addr;        // Large enough for both IPv4 or IPv6
-            socklen_t addr_len = sizeof (source_addr);
-            csock = accept (lsock, (struct sockaddr *) &source_addr, &addr_len);
-            char addr_str[40] = "";
-            if (source_addr.ss_family == PF_INET)
-               inet_ntoa_r (((struct sockaddr_in *) &source_addr)->sin_addr, addr_str, sizeof (addr_str) - 1);
-            else if (source_addr.ss_family == PF_INET6)
-               inet6_ntoa_r (((struct sockaddr_in6 *) &source_addr)->sin6_addr, addr_str, sizeof (addr_str) - 1);
+            char addr_str[40];
+            int s = tcp_accept (lsock, addr_str, sizeof (addr_str));
+            int m = 0;
+            if (s >= 0)
+            {
+               if (csock < 0)
+               {
+                  csock = s;
+                  tcptxn = 0;
+                  power = 1;
+                  if ((b.tcptelnet = telnet))
+                     telnet_start (&tn, csock);
+               } else if (!(m = monitor_accept (s)))
+               {                // No monitor space
+                  close (s);
+                  m = -1;
+               }
+            }
             jo_t j = jo_object_alloc ();
             jo_string (j, "ip", addr_str);
-            revk_event ("connect", &j);
+            if (m < 0)
+            {
+               jo_string (j, "reason", "busy");
+               revk_event ("closed", &j);
+            } else
+            {
+               if (m)
+                  jo_int (j, "monitor", m);
+               revk_event ("connect", &j);
+            }
+            reportstate ();
+         }
+      }
+      if (b.dolease)
+      {                         // Lease handover, the monitor gets keyboard and printer, the holder becomes a monitor
+         b.dolease = 0;
+         int s = monitor_take (leaseto);
+         if (s >= 0)
+         {
+            tcpflush ();
+            int m = 0;
+            if (csock >= 0 && !(m = monitor_accept (csock)))
+               close (csock);   // Cannot happen, as the monitor slot was just freed
+            csock = s;
+            tcptxn = 0;
             power = 1;
+            if ((b.tcptelnet = telnet))
+               telnet_start (&tn, csock);
+            jo_t j = jo_object_alloc ();
+            if (leaseto)
+               jo_int (j, "from", leaseto);
+            if (m)
+               jo_int (j, "monitor", m);
+            revk_event ("lease", &j);
+            reportstate ();
          }
       }
-      if (hayes == 3 && gap > 1000000)
-      {                         // End of Hayes +++ escape sequence
-         hayes++;               // Command prompt
+      if (!bisting && hayes_escape (&hayes, lastrx, now))
+      {                         // End of Hayes +++ escape sequence, command prompt
          rxp = 0;
          sendstring ("\nASR33 CONTROLLER (BUILD ");
          sendstring (revk_version);
@@ -641,16 +948,21 @@ asr33_main (void *param)
             sendstring ("WOULD YOU LIKE TO PLAY A GAME? (Y/N)\n> ");
       }
       // Check tcp
-      if (csock >= 0)
+      if (csock >= 0 && tty_tx_space () >= tcpspace)
       {
          fd_set s;
          FD_ZERO (&s);
          FD_SET (csock, &s);
          struct timeval timeout = { };
          if (select (csock + 1, &s, NULL, NULL, &timeout) > 0)
-         {
-            uint8_t b = 0;
-            int len = recv (csock, &b, 1, 0);
+         {                      // As much as there is tx space for
+            uint8_t buf[MAXTCP];
+            int len = tty_tx_space ();
+            if (ita2 && len > 1)
+               len /= 2;        // ITA2 can add a shift before each code, so as queued with wait this still does not block
+            if (len > sizeof (buf))
+               len = sizeof (buf);
+            len = recv (csock, buf, len, 0);
             if (len <= 0)
             {                   // Closed
                close (csock);
@@ -659,10 +971,19 @@ asr33_main (void *param)
                jo_string (j, "reason", "close");
                revk_event ("closed", &j);
             } else
-               sendbyte (b);    // Raw send to teletype
+            {
+               if (b.tcptelnet)
+                  len = telnet_rx (&tn, csock, buf, len);
+               if (len)
+                  sendblock (buf, len); // Raw send to teletype
+            }
          }
       }
-      int len = tty_rx_ready ();
+      int len = (bisting ? 0 : tty_rx_ready ());        // Self test task reads rx while running
+      int64_t rxt;
+      int rxc = -1;
+      if (len > 0 && (rxc = tty_rx_ts (&rxt)) < 0)
+         len = 0;               // Only ITA2 shifts, nothing typed
       if (!len)
       {                         // Nothing waiting and not break
          if (b.brk)
@@ -694,14 +1015,21 @@ asr33_main (void *param)
             power = 0;          // Abort power off
          if (!b.on)
             dorun ();           // Must be not using power controls, so turn on for rx data
-         uint8_t byte = tty_rx ();
+         uint8_t byte = rxc;
+         gap = rxt - lastrx;    // Gap from when the previous byte actually arrived, not when we polled
          xSemaphoreTake (rxws_mutex, portMAX_DELAY);
          if (rxwsp < sizeof (rxws))
             rxws[rxwsp++] = byte;
          xSemaphoreGive (rxws_mutex);
+         monitor_add (&byte, 1);
          if (csock >= 0)
-            send (csock, &byte, 1, 0);  // Connected via TCP
-         else
+         {                      // Connected via TCP, gathered to send
+            if (!tcptxn)
+               tcptxt = now;
+            tcptx[tcptxn++] = byte;
+            if (tcptxn == sizeof (tcptx) || (linemode && ((byte & 0x7F) == CR || (byte & 0x7F) == LF)))
+               tcpflush ();     // Full, or end of line
+         } else
          {                      // Not connected via TCP
             if (gap > 250000)
                b.suppress = 0;  // Suppressed WRU response timeout can end
@@ -732,26 +1060,17 @@ asr33_main (void *param)
                   }
                } else if ((byte & 0x7f) >= ' ' && rxp < MAXRX)
                {
-                  sendbyte (byte);      // echo
+                  sendecho (byte);
                   line[rxp++] = (byte & 0x7F);
                }
             } else
             {
-               if (!hayes)
-               {
-                  if (byte == pe ('+') && !rxp && gap > 1000000)
-                     hayes++;
-               } else
-               {
-                  if (byte != pe ('+') || hayes >= 3 || gap > 1000000)
-                     hayes = 0;
-                  else
-                     hayes++;
-               }
+               hayes_rx (&hayes, byte, !rxp, gap);
                if (!b.suppress)
                {
                   jo_t j = jo_object_alloc ();
                   jo_int (j, "byte", byte);
+                  jo_int (j, "latency", esp_timer_get_time () - rxt);   // us from stop bit to event
                   revk_event ("rx", &j);
                   if (byte == pe (EOT))
                      power = -1;        // EOT to shut down
@@ -769,8 +1088,7 @@ asr33_main (void *param)
                      {          // Doing large lettering
                         if (byte == pe (DC4))
                         {       // End
-                           for (int i = 0; i < 9; i++)
-                              sendbyte (NUL);
+                           sendnul (9);
                            sendbyte (pe (DC4));
                            b.dobig = 0;
                         } else if (byte == pe (byte) && (byte & 0x7F) >= 0x20 && queuebig (byte & 0x7F))
@@ -778,8 +1096,7 @@ asr33_main (void *param)
                      } else if (byte == pe (DC2) && b.doecho && !nobig)
                      {          // Start big lettering
                         sendbyte (pe (DC2));
-                        for (int i = 0; i < 10; i++)
-                           sendbyte (NUL);
+                        sendnul (10);
                         b.dobig = 1;
                      }
                      // else if (byte == pe(RU) && !nocave) b.docave = 1;
@@ -807,16 +1124,24 @@ asr33_main (void *param)
                         if (ack)
                            sendbyte (pe (ack)); // ACK
                      } else if (!b.xoff)
-                        sendbyte (byte);
+                     {          // Echo
+                        sendecho (byte);
+                     }
                   }
                }
             }
          }
-         lastrx = now;
+         lastrx = rxt;
       }
-      if (!tty_tx_waiting () && csock < 0)
-      {                         // Nothing to send
-         if (b.docave)
+      if (!bisting && !tty_tx_waiting () && csock < 0)
+      {                         // Nothing to send, and not in self test
+         if (b.dobist && !monitor_count ())
+         {                      // Self test, in its own task, so sockets, monitors, and other lines carry on
+            b.dobist = 0;
+            bisting = 1;
+            revk_blink (1, 0, "Y");
+            xTaskCreate (bist_task, "bist", 4 * 1024, NULL, 2, NULL);
+         } else if (b.docave)
          {                      // Let's play a game
             b.docave = 0;
             extern int advent (void);
@@ -832,6 +1157,28 @@ asr33_main (void *param)
             power = -1;
       } else
          done = now + 1000 * (power > 1 ? timekeyidle : timeremidle);
+      {                         // Monitors, copy of session sent as each can take it
+         int mc = monitor_count ();
+         monitor_poll ();
+         if (monitor_count () != mc)
+            reportstate ();     // Monitor closed
+      }
+      if (tcptxn && (!linemode || timeflush))
+      {                         // Line mode waits for end of line, or flush time if set
+         if ((linemode || tty_rx_ready () <= 0) && now >= tcptxt + timeflush * 1000LL)
+            tcpflush ();        // Nothing more arrived (or flush time, if set, passed)
+         else
+            due (tcptxt + timeflush * 1000LL);
+      }
+      // When next needed, if not woken by a socket, rx, break, tx drained, RUN button, or command
+      if ((!bisting && tty_rx_ready () > 0) || (power < 0 && b.on && !tty_tx_waiting ()) || (power > 0 && !b.on))
+         due (now);             // More to do
+      if (!bisting && hayes_due (hayes, lastrx))
+         due (hayes_due (hayes, lastrx));       // Hayes guard time
+      if (tty_tx_waiting ())
+         due (now + 100000);    // Busy state and LED
+      else if (b.on && csock < 0)
+         due (done);            // Idle power off
    }
 }
 
@@ -928,7 +1275,7 @@ web_live (httpd_req_t * req)
    ret = httpd_ws_recv_frame (req, &ws_pkt, ws_pkt.len);
    if (!ret)
    {
-      jo_t j = jo_parse_mem (buf, ws_pkt.len);
+      jo_t j = (bisting ? NULL : jo_parse_mem (buf, ws_pkt.len));        // Not while self test running
       if (j)
       {                         // handle commands
          if (jo_find (j, "text"))
@@ -951,8 +1298,7 @@ web_live (httpd_req_t * req)
                power = 1;
                if (!nodc4)
                   sendbyte (DC2);       // Tape on
-               for (int i = 0; i < tapelead; i++)
-                  sendbyte (NUL);
+               sendnul (tapelead);
                char *text = jo_strdup (j),
                   *value = text;
                while (len--)
@@ -963,8 +1309,7 @@ web_live (httpd_req_t * req)
                      sendbyte (NUL);
                }
                free (text);
-               for (int i = 0; i < tapetail; i++)
-                  sendbyte (NUL);
+               sendnul (tapetail);
                if (!nodc4)
                {
                   sendbyte (DC4);       // Tape off
@@ -982,6 +1327,7 @@ web_live (httpd_req_t * req)
             tty_stats (NULL, 1);
          }
          jo_free (&j);
+         wake ();
       }
    }
    free (buf);
@@ -1007,7 +1353,8 @@ web_root (httpd_req_t * req)
                   "ws.onmessage=function(v){"   //
                   "o=JSON.parse(v.data);"       //
                   "if(o.shutdown){reboot=true;s('shutdown','Restarting: '+o.shutdown);};"       //
-                  "s('stats','Tx:'+o.tx+' Rx:'+o.rx+(o.rxlevel?'(1)':'(0)')+' Bad: Start:'+o.rxbadstart+' Stop:'+o.rxbadstop+' Zero:'+o.rxbad0+'/'+o.rxbadish0+' One:'+o.rxbad1+'/'+o.rxbadish1+' Parity:'+o.rxbadp+(o.brk?' BREAK':'')+(o.power?' (power on)':''));"   //
+                  "s('stats','Tx:'+o.tx+' Rx:'+o.rx+(o.rxlevel?'(1)':'(0)')+' Bad: Start:'+o.rxbadstart+' Stop:'+o.rxbadstop+' Zero:'+o.rxbad0+'/'+o.rxbadish0+' One:'+o.rxbad1+'/'+o.rxbadish1+' Parity:'+o.rxbadp+' Overrun:'+o.rxoverrun+' High: Tx:'+o.txhigh+' Rx:'+o.rxhigh+(o.brk?' BREAK':'')+(o.power?' (power on)':''));"   //
+                  "if(o.meter)s('meter','Meter: Speed:'+o.meter.speed+'% Bias:'+o.meter.bias+'% Peak:'+o.meter.peak+'% Stop:'+o.meter.stop+' bits ('+o.meter.chars+' chars'+(o.rxbaud?' at '+o.rxbaud+' baud':'')+')');"      //
                   "if(o.data)g('rx').append(o.data);"   //
                   "};};c();"    //
                   "setInterval(function() {if(!ws)c();else ws.send('');},1000);"        //
@@ -1019,6 +1366,7 @@ web_root (httpd_req_t * req)
                   "<input type=button value='WRU' onclick='w(\"wru\",true);'>"  //
                   "<input type=button value='Clear stats' onclick='w(\"clear\",true);'>"        //
                   "<p id=stats></p>"    //
+                  "<p id=meter></p>"    //
                   "<pre id=rx style='border:1px solid blue;'></pre>"    //
                   "</form>"     //
                   , hostname);
@@ -12,8 +12,7 @@ extern int8_t uart;
 void
 pesend (const char *line, int len)
 {
-   while (len-- > 0)
-      tty_tx (*line++);
+   tty_tx_buf ((const uint8_t *) line, len, 1);
 }
 
 void
@@ -32,14 +31,13 @@ readline (const char *prompt)
    int p = 0;
    while (1)
    {
-      usleep (10000);
-      char b = tty_rx ();
+      char b = tty_rx ();       // Blocks until a byte arrives
       b &= 0x7F;
       if (b == 4)
          return NULL;           // EOF
       if (b == 0x7F)
       {
-         pesend ("\r", 2);      // \r and NULL
+         pesend ("\r", 1);
          pesend (prompt, strlen (prompt));
          p = 0;
          continue;
@@ -57,8 +55,8 @@ readline (const char *prompt)
    line[p] = 0;
    extern uint8_t think;
    pesend ("\r\n\n", 3);
-   for (int i = 0; i < think; i++)
-      pesend ("", 1);
+   if (think)
+      tty_tx_rep (0, think);    // Thinking time
    return strdup (line);
 }
 
@@ -0,0 +1,145 @@
+// Baudot / ITA2 5 bit codec, US TTY figures (Model 15/28)
+// Copyright © 2026 Adrian Kennard, Andrews & Arnold Ltd. See LICENCE file for details. GPL 3.0
+//
+// Space, CR, LF and blank are in both shifts, so never need a shift. Every other character is in exactly one shift,
+// so only sending a shift when the character needs the other shift gives the fewest shifts possible.
+// Note this assumes the machine does not unshift on space.
+
+#include "ita2.h"
+
+#define	L	0x20            // In letters shift
+#define	F	0x40            // In figures shift
+#define	B	(L|F)           // In both
+
+static const uint8_t ita2_ltrs[32] = {
+   0, 'E', '\n', 'A', ' ', 'S', 'I', 'U', '\r', 'D', 'R', 'J', 'N', 'F', 'C', 'K',
+   'T', 'Z', 'L', 'W', 'H', 'Y', 'P', 'Q', 'O', 'B', 'G', 0, 'M', 'X', 'V', 0
+};
+static const uint8_t ita2_figs[32] = {
+   0, '3', '\n', '-', ' ', '\a', '8', '7', '\r', '$', '4', '\'', ',', '!', ':', '(',
+   '5', '"', ')', '2', '#', '6', '0', '1', '9', '?', '&', 0, '.', '/', ';', 0
+};
+
+static const uint8_t ita2_ascii[128] = {     // ASCII to code and shift(s)
+   [0] = B | 0x00,
+   ['\a'] = F | 0x05,
+   ['\n'] = B | 0x02,
+   ['\r'] = B | 0x08,
+   [' '] = B | 0x04,
+   ['!'] = F | 0x0D,
+   ['"'] = F | 0x11,
+   ['#'] = F | 0x14,
+   ['$'] = F | 0x09,
+   ['&'] = F | 0x1A,
+   ['\''] = F | 0x0B,
+   ['('] = F | 0x0F,
+   [')'] = F | 0x12,
+   [','] = F | 0x0C,
+   ['-'] = F | 0x03,
+   ['.'] = F | 0x1C,
+   ['/'] = F | 0x1D,
+   ['0'] = F | 0x16,
+   ['1'] = F | 0x17,
+   ['2'] = F | 0x13,
+   ['3'] = F | 0x01,
+   ['4'] = F | 0x0A,
+   ['5'] = F | 0x10,
+   ['6'] = F | 0x15,
+   ['7'] = F | 0x07,
+   ['8'] = F | 0x06,
+   ['9'] = F | 0x18,
+   [':'] = F | 0x0E,
+   [';'] = F | 0x1E,
+   ['?'] = F | 0x19,
+   ['A'] = L | 0x03,
+   ['B'] = L | 0x19,
+   ['C'] = L | 0x0E,
+   ['D'] = L | 0x09,
+   ['E'] = L | 0x01,
+   ['F'] = L | 0x0D,
+   ['G'] = L | 0x1A,
+   ['H'] = L | 0x14,
+   ['I'] = L | 0x06,
+   ['J'] = L | 0x0B,
+   ['K'] = L | 0x0F,
+   ['L'] = L | 0x12,
+   ['M'] = L | 0x1C,
+   ['N'] = L | 0x0C,
+   ['O'] = L | 0x18,
+   ['P'] = L | 0x16,
+   ['Q'] = L | 0x17,
+   ['R'] = L | 0x0A,
+   ['S'] = L | 0x05,
+   ['T'] = L | 0x10,
+   ['U'] = L | 0x07,
+   ['V'] = L | 0x1E,
+   ['W'] = L | 0x13,
+   ['X'] = L | 0x1D,
+   ['Y'] = L | 0x15,
+   ['Z'] = L | 0x11,
+   ['a'] = L | 0x03,
+   ['b'] = L | 0x19,
+   ['c'] = L | 0x0E,
+   ['d'] = L | 0x09,
+   ['e'] = L | 0x01,
+   ['f'] = L | 0x0D,
+   ['g'] = L | 0x1A,
+   ['h'] = L | 0x14,
+   ['i'] = L | 0x06,
+   ['j'] = L | 0x0B,
+   ['k'] = L | 0x0F,
+   ['l'] = L | 0x12,
+   ['m'] = L | 0x1C,
+   ['n'] = L | 0x0C,
+   ['o'] = L | 0x18,
+   ['p'] = L | 0x16,
+   ['q'] = L | 0x17,
+   ['r'] = L | 0x0A,
+   ['s'] = L | 0x05,
+   ['t'] = L | 0x10,
+   ['u'] = L | 0x07,
+   ['v'] = L | 0x1E,
+   ['w'] = L | 0x13,
+   ['x'] = L | 0x1D,
+   ['y'] = L | 0x15,
+   ['z'] = L | 0x11,
+};
+
+void
+ita2_reset (ita2_t * s)
+{
+   s->tx = 0;
+   s->rx = ITA2_LTRS;
+}
+
+int
+ita2_encode (ita2_t * s, uint8_t c, uint8_t * out)
+{
+   uint8_t e = ita2_ascii[c & 0x7F];
+   if (!e)
+      return 0;                 // No ITA2 equivalent
+   int n = 0;
+   if (!(e & L))
+   {
+      if (s->tx != ITA2_FIGS)
+         out[n++] = s->tx = ITA2_FIGS;
+   } else if (!(e & F))
+   {
+      if (s->tx != ITA2_LTRS)
+         out[n++] = s->tx = ITA2_LTRS;
+   }
+   out[n++] = (e & 0x1F);
+   return n;
+}
+
+uint8_t
+ita2_decode (ita2_t * s, uint8_t code)
+{
+   code &= 0x1F;
+   if (code == ITA2_LTRS || code == ITA2_FIGS)
+   {
+      s->rx = code;
+      return 0;
+   }
+   return (s->rx == ITA2_FIGS ? ita2_figs : ita2_ltrs)[code];
+}
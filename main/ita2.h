@@ -0,0 +1,23 @@
+// Baudot / ITA2 5 bit codec, US TTY figures (Model 15/28)
+// Copyright © 2026 Adrian Kennard, Andrews & Arnold Ltd. See LICENCE file for details. GPL 3.0
+
+#ifndef	ITA2_H
+#define	ITA2_H
+
+#include <stdint.h>
+
+#define	ITA2_LTRS	0x1F
+#define	ITA2_FIGS	0x1B
+
+typedef struct ita2_s ita2_t;
+struct ita2_s
+{
+   uint8_t tx;                  // Tx shift state, 0 unknown, else ITA2_LTRS or ITA2_FIGS
+   uint8_t rx;                  // Rx shift state
+};
+
+void ita2_reset (ita2_t *);     // Set shift state unknown (tx) and letters (rx)
+int ita2_encode (ita2_t *, uint8_t c, uint8_t * out);   // ASCII to ITA2, puts 0-2 codes in out (shift if needed), returns count
+uint8_t ita2_decode (ita2_t *, uint8_t code);   // ITA2 to ASCII, returns 0 for shift codes
+
+#endif
@@ -82,10 +82,7 @@ vspeak (const char *msg, bool blank, va_list ap)
          } else
          {
             if (msg[i] == '\n')
-            {
-               *renderp++ = '\r';
-               *renderp++ = 0;  // Time padding
-            }
+               *renderp++ = '\r';      // CR time is allowed by the soft UART
             *renderp++ = msg[i];
             size--;
          }
@@ -0,0 +1,194 @@
+// TCP session monitors, read only connections to the main TCP port that see a copy of the session
+// Copyright © 2026 Adrian Kennard, Andrews & Arnold Ltd. See LICENCE file for details. GPL 3.0
+// One connection (csock in ASR33.c) holds the lease, i.e. keyboard and printer, others connecting while it is held are monitors
+// Session rx and tx go in one ring, each monitor has its own cursor, and is sent to without blocking
+// So a slow monitor falls behind and loses data, it does not slow the session
+// Anything a monitor sends is discarded, the lease moves to a monitor by command, the previous holder becoming a monitor
+// With telnet, IAC is doubled, but monitors are not sent option negotiation until they get the lease
+// Tx is added from any task that sends to the teletype (via tty_tx_tap), so the ring is under a mutex
+// That is as tx is queued, not as printed, so monitors can be up to the tx ring ahead of the paper
+
+#include "revk.h"
+#include "monitor.h"
+#include "telnet.h"
+
+#define	MONRING		4096    // Ring of session traffic, power of 2
+
+static uint8_t ring[MONRING];
+static uint32_t ringw = 0;      // Bytes written to ring (not wrapped)
+static SemaphoreHandle_t ring_mutex = NULL;
+static struct
+{
+   int sock;                    // Socket, -1 if not in use
+   uint32_t pos;                // Bytes of ring sent (not wrapped)
+   uint32_t lost;               // Bytes lost by falling behind
+} mon[MONITORS];
+
+static void
+mclose (int n, const char *reason)
+{
+   close (mon[n].sock);
+   mon[n].sock = -1;
+   jo_t j = jo_object_alloc ();
+   jo_string (j, "reason", reason);
+   jo_int (j, "monitor", n + 1);
+   if (mon[n].lost)
+      jo_int (j, "lost", mon[n].lost);
+   revk_event ("closed", &j);
+}
+
+void
+monitor_setup (void)
+{
+   for (int n = 0; n < MONITORS; n++)
+      mon[n].sock = -1;
+   ring_mutex = xSemaphoreCreateMutex ();
+}
+
+int
+monitor_count (void)
+{                               // Number of monitors connected
+   int c = 0;
+   for (int n = 0; n < MONITORS; n++)
+      if (mon[n].sock >= 0)
+         c++;
+   return c;
+}
+
+static void
+ring_add (const uint8_t * buf, int len)
+{
+   if (len > MONRING)
+   {                            // Only the last of it can be in the ring
+      ringw += len - MONRING;
+      buf += len - MONRING;
+      len = MONRING;
+   }
+   while (len > 0)
+   {
+      int p = (ringw & (MONRING - 1));
+      int l = MONRING - p;
+      if (l > len)
+         l = len;
+      memcpy (ring + p, buf, l);
+      ringw += l;
+      buf += l;
+      len -= l;
+   }
+}
+
+void
+monitor_add (const uint8_t * buf, int len)
+{                               // Session traffic, sent to monitors by monitor_poll
+   if (!monitor_count ())
+      return;
+   xSemaphoreTake (ring_mutex, portMAX_DELAY);
+   if (telnet)
+   {                            // IAC doubled
+      const uint8_t *f;
+      while ((f = memchr (buf, TELNET_IAC, len)))
+      {
+         int l = f - buf + 1;
+         ring_add (buf, l);
+         ring_add (f, 1);
+         buf += l;
+         len -= l;
+      }
+   }
+   ring_add (buf, len);
+   xSemaphoreGive (ring_mutex);
+}
+
+int
+monitor_accept (int s)
+{                               // Take a new connection as a monitor, returns monitor number, 0 if none free
+   for (int n = 0; n < MONITORS; n++)
+      if (mon[n].sock < 0)
+      {
+         xSemaphoreTake (ring_mutex, portMAX_DELAY);
+         mon[n].pos = ringw;    // From now
+         mon[n].lost = 0;
+         mon[n].sock = s;
+         xSemaphoreGive (ring_mutex);
+         return n + 1;
+      }
+   return 0;
+}
+
+int
+monitor_take (int n)
+{                               // Take monitor n (1 to MONITORS, or 0 for the first), for the lease, returns socket, -1 if none
+   if (n < 0 || n > MONITORS)
+      return -1;
+   if (!n)
+      while (n < MONITORS && mon[n].sock < 0)
+         n++;
+   else
+      n--;
+   if (n == MONITORS || mon[n].sock < 0)
+      return -1;
+   int s = mon[n].sock;
+   mon[n].sock = -1;
+   return s;
+}
+
+int
+monitor_fds (fd_set * r, fd_set * w, int max)
+{                               // Add sockets to wait on, readable (for close), and writable if behind, returns max fd
+   for (int n = 0; n < MONITORS; n++)
+   {
+      int s = mon[n].sock;
+      if (s < 0)
+         continue;
+      FD_SET (s, r);
+      if (mon[n].pos != ringw)
+         FD_SET (s, w);
+      if (s > max)
+         max = s;
+   }
+   return max;
+}
+
+void
+monitor_poll (void)
+{                               // Called from main loop, does not block
+   for (int n = 0; n < MONITORS; n++)
+   {
+      int s = mon[n].sock;
+      if (s < 0)
+         continue;
+      uint8_t buf[64];
+      int l = recv (s, buf, sizeof (buf), MSG_DONTWAIT);
+      if (!l || (l < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+      {
+         mclose (n, "close");
+         continue;
+      }
+      char err = 0;
+      xSemaphoreTake (ring_mutex, portMAX_DELAY);
+      uint32_t behind = ringw - mon[n].pos;
+      if (behind > MONRING)
+      {                         // Too slow, skip to what is still in the ring
+         mon[n].lost += behind - MONRING;
+         mon[n].pos = ringw - MONRING;
+         behind = MONRING;
+      }
+      while (behind)
+      {                         // Not blocking, so OK with the mutex held
+         int p = (mon[n].pos & (MONRING - 1));
+         l = MONRING - p;
+         if (l > behind)
+            l = behind;
+         l = send (s, ring + p, l, MSG_DONTWAIT);
+         if (l < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+            err = 1;
+         if (l <= 0)
+            break;              // Full, carry on when writable
+         mon[n].pos += l;
+         behind -= l;
+      }
+      xSemaphoreGive (ring_mutex);
+      if (err)
+         mclose (n, "error");
+   }
+}
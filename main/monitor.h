@@ -0,0 +1,11 @@
+// TCP session monitors
+
+#define	MONITORS	3       // Monitor connections, as well as the one with the lease
+
+void monitor_setup (void);
+int monitor_count (void);
+void monitor_add (const uint8_t *, int len);
+int monitor_accept (int s);
+int monitor_take (int n);
+int monitor_fds (fd_set * r, fd_set * w, int max);
+void monitor_poll (void);
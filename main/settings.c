@@ -32,43 +32,64 @@ revk_settings_t const revk_settings[]={
  {.type=REVK_SETTINGS_UNSIGNED,.name="tapelead",.comment="Tape lead NULLs",.group=3,.len=8,.dot=4,.def="15",.ptr=&tapelead,.size=sizeof(uint8_t)},
  {.type=REVK_SETTINGS_UNSIGNED,.name="tapetail",.comment="Tape tail NULLs",.group=3,.len=8,.dot=4,.def="15",.ptr=&tapetail,.size=sizeof(uint8_t)},
  {.type=REVK_SETTINGS_UNSIGNED,.name="port",.comment="TCP port",.len=4,.def="33",.ptr=&port,.size=sizeof(uint16_t)},
+ {.type=REVK_SETTINGS_BIT,.name="telnet",.comment="Telnet on TCP port, with RFC 2217 com port control",.len=6,.bit=REVK_SETTINGS_BITFIELD_telnet},
+ {.type=REVK_SETTINGS_BIT,.name="linemode",.comment="Gather typed characters to end of line for TCP, and telnet line at a time",.len=8,.bit=REVK_SETTINGS_BITFIELD_linemode},
+ {.type=REVK_SETTINGS_BIT,.name="tcpnodelay",.comment="TCP_NODELAY, no Nagle, send TCP segments at once",.len=10,.bit=REVK_SETTINGS_BITFIELD_tcpnodelay},
  {.type=REVK_SETTINGS_UNSIGNED,.name="baud",.comment="Baud rate",.len=4,.def="110",.ptr=&baud,.size=sizeof(uint16_t),.decimal=2},
  {.type=REVK_SETTINGS_UNSIGNED,.name="databits",.comment="Data bits",.len=8,.def="8",.ptr=&databits,.size=sizeof(uint8_t)},
- {.type=REVK_SETTINGS_UNSIGNED,.name="stop",.comment="Stop bits (multiples of 0.5 bits)",.len=4,.def="2",.ptr=&stop,.size=sizeof(uint8_t),.decimal=1},
+ {.type=REVK_SETTINGS_UNSIGNED,.name="stop",.comment="Stop bits",.len=4,.def="2",.ptr=&stop,.size=sizeof(uint8_t),.decimal=1},
+ {.type=REVK_SETTINGS_UNSIGNED,.name="oversample",.comment="Soft UART interrupts per bit (5, 8, or 16)",.len=10,.def="5",.ptr=&oversample,.size=sizeof(uint8_t)},
  {.type=REVK_SETTINGS_UNSIGNED,.name="linelen",.comment="Line length characters",.len=7,.def="72",.ptr=&linelen,.size=sizeof(uint8_t)},
+ {.type=REVK_SETTINGS_UNSIGNED,.name="txbuf",.comment="Tx buffer size (bytes)",.len=5,.def="32768",.ptr=&txbuf,.size=sizeof(uint32_t)},
+ {.type=REVK_SETTINGS_UNSIGNED,.name="rxbuf",.comment="Rx buffer size (bytes)",.len=5,.def="32",.ptr=&rxbuf,.size=sizeof(uint16_t)},
+ {.type=REVK_SETTINGS_BIT,.name="txpsram",.comment="Tx buffer in PSRAM (if fitted)",.len=7,.bit=REVK_SETTINGS_BITFIELD_txpsram},
+ {.type=REVK_SETTINGS_BIT,.name="ita2",.comment="Translate ASCII to and from 5 bit Baudot (ITA2)",.len=4,.bit=REVK_SETTINGS_BITFIELD_ita2},
+ {.type=REVK_SETTINGS_BIT,.name="rxedge",.comment="Soft UART rx by edge interrupt and decoder task, not timer sampling",.len=6,.bit=REVK_SETTINGS_BITFIELD_rxedge},
+ {.type=REVK_SETTINGS_BIT,.name="autobaud",.comment="Auto-baud on rx (rxedge only), 45.45/50/56.88/74.2/110",.len=8,.bit=REVK_SETTINGS_BITFIELD_autobaud},
  {.type=REVK_SETTINGS_UNSIGNED,.name="timecr",.comment="Time for CR (s) for whole line",.group=4,.len=6,.dot=4,.def="0.2",.ptr=&timecr,.size=sizeof(uint16_t),.decimal=3,.old="crtime"	},
+ {.type=REVK_SETTINGS_UNSIGNED,.name="timelf",.comment="Time for LF (s)",.group=4,.len=6,.dot=4,.def="0",.ptr=&timelf,.size=sizeof(uint16_t),.decimal=3},
+ {.type=REVK_SETTINGS_UNSIGNED,.name="timebel",.comment="Time for BEL (s)",.group=4,.len=7,.dot=4,.def="0",.ptr=&timebel,.size=sizeof(uint16_t),.decimal=3},
+ {.type=REVK_SETTINGS_UNSIGNED,.name="timetab",.comment="Time for TAB (s)",.group=4,.len=7,.dot=4,.def="0",.ptr=&timetab,.size=sizeof(uint16_t),.decimal=3},
+ {.type=REVK_SETTINGS_UNSIGNED,.name="timedc2",.comment="Time for DC2 (s), punch on, holds all tx",.group=4,.len=7,.dot=4,.def="0",.ptr=&timedc2,.size=sizeof(uint16_t),.decimal=3},
  {.type=REVK_SETTINGS_UNSIGNED,.name="timepwron",.comment="Time for power on",.group=4,.len=9,.dot=4,.def="0.1",.ptr=&timepwron,.size=sizeof(uint16_t),.decimal=3},
  {.type=REVK_SETTINGS_UNSIGNED,.name="timemtron",.comment="Time for motor on",.group=4,.len=9,.dot=4,.def="0.25",.ptr=&timemtron,.size=sizeof(uint16_t),.decimal=3},
  {.type=REVK_SETTINGS_UNSIGNED,.name="timemtroff",.comment="Time for motor off",.group=4,.len=10,.dot=4,.def="1.25",.ptr=&timemtroff,.size=sizeof(uint16_t),.decimal=3},
  {.type=REVK_SETTINGS_UNSIGNED,.name="timepwroff",.comment="Time for power off",.group=4,.len=10,.dot=4,.def="0.2",.ptr=&timepwroff,.size=sizeof(uint16_t),.decimal=3},
  {.type=REVK_SETTINGS_UNSIGNED,.name="timeremidle",.comment="Idle time at end of remote",.group=4,.len=11,.dot=4,.def="1",.ptr=&timeremidle,.size=sizeof(uint32_t),.decimal=3,.old="idle"	},
  {.type=REVK_SETTINGS_UNSIGNED,.name="timekeyidle",.comment="Idle time at end of manual working",.group=4,.len=11,.dot=4,.def="600",.ptr=&timekeyidle,.size=sizeof(uint32_t),.decimal=3,.old="keyidle"	},
+ {.type=REVK_SETTINGS_UNSIGNED,.name="timeflush",.comment="Time to gather rx in to one TCP send (s)",.group=4,.len=9,.dot=4,.def="0",.ptr=&timeflush,.size=sizeof(uint16_t),.decimal=3},
+ {.type=REVK_SETTINGS_UNSIGNED,.gpio=1,.name="ttytx",.comment="Extra line Tx",.group=5,.len=5,.dot=3,.ptr=&ttytx,.size=sizeof(revk_gpio_t),.fix=1,.set=1,.flags="- ~↓↕⇕",.array=3},
+ {.type=REVK_SETTINGS_UNSIGNED,.gpio=1,.name="ttyrx",.comment="Extra line Rx",.group=5,.len=5,.dot=3,.ptr=&ttyrx,.size=sizeof(revk_gpio_t),.fix=1,.set=1,.flags="- ~↓↕⇕",.array=3},
+ {.type=REVK_SETTINGS_UNSIGNED,.name="ttyport",.comment="Extra line TCP port",.group=5,.len=7,.dot=3,.ptr=&ttyport,.size=sizeof(uint16_t),.array=3},
+ {.type=REVK_SETTINGS_UNSIGNED,.name="ttybaud",.comment="Extra line baud rate (0 for baud)",.group=5,.len=7,.dot=3,.ptr=&ttybaud,.size=sizeof(uint16_t),.decimal=2,.array=3},
+ {.type=REVK_SETTINGS_UNSIGNED,.name="ttydatabits",.comment="Extra line data bits (0 for databits)",.group=5,.len=11,.dot=3,.ptr=&ttydatabits,.size=sizeof(uint8_t),.array=3},
+ {.type=REVK_SETTINGS_UNSIGNED,.name="ttystop",.comment="Extra line stop bits (0 for stop)",.group=5,.len=7,.dot=3,.ptr=&ttystop,.size=sizeof(uint8_t),.decimal=1,.array=3},
 #ifdef	CONFIG_REVK_SETTINGS_PASSWORD
  {.type=REVK_SETTINGS_STRING,.name="password",.comment="Settings password (this is not sent securely so use with care on local networks you control)",.len=8,.ptr=&password,.malloc=1,.revk=1,.hide=1,.secret=1},
 #endif
  {.type=REVK_SETTINGS_STRING,.name="hostname",.comment="Host name",.len=8,.ptr=&hostname,.malloc=1,.revk=1,.hide=1},
  {.type=REVK_SETTINGS_STRING,.name="appname",.comment="Application name",.len=7,.dq=1,.def=quote(CONFIG_REVK_APPNAME),.ptr=&appname,.malloc=1,.revk=1,.hide=1},
- {.type=REVK_SETTINGS_STRING,.name="otahost",.comment="OTA hostname",.group=5,.len=7,.dot=3,.dq=1,.def=quote(CONFIG_REVK_OTAHOST),.ptr=&otahost,.malloc=1,.revk=1,.live=1},
- {.type=REVK_SETTINGS_UNSIGNED,.name="otadays",.comment="OTA auto load (days)",.group=5,.len=7,.dot=3,.dq=1,.def=quote(CONFIG_REVK_OTADAYS),.ptr=&otadays,.size=sizeof(uint8_t),.revk=1},
- {.type=REVK_SETTINGS_UNSIGNED,.name="otastart",.comment="OTA check after startup (min seconds)",.group=5,.len=8,.dot=3,.def="600",.ptr=&otastart,.size=sizeof(uint16_t),.revk=1},
- {.type=REVK_SETTINGS_BIT,.name="otaauto",.comment="OTA auto upgrade",.group=5,.len=7,.dot=3,.def="1",.bit=REVK_SETTINGS_BITFIELD_otaauto,.revk=1,.hide=1,.live=1},
+ {.type=REVK_SETTINGS_STRING,.name="otahost",.comment="OTA hostname",.group=6,.len=7,.dot=3,.dq=1,.def=quote(CONFIG_REVK_OTAHOST),.ptr=&otahost,.malloc=1,.revk=1,.live=1},
+ {.type=REVK_SETTINGS_UNSIGNED,.name="otadays",.comment="OTA auto load (days)",.group=6,.len=7,.dot=3,.dq=1,.def=quote(CONFIG_REVK_OTADAYS),.ptr=&otadays,.size=sizeof(uint8_t),.revk=1},
+ {.type=REVK_SETTINGS_UNSIGNED,.name="otastart",.comment="OTA check after startup (min seconds)",.group=6,.len=8,.dot=3,.def="600",.ptr=&otastart,.size=sizeof(uint16_t),.revk=1},
+ {.type=REVK_SETTINGS_BIT,.name="otaauto",.comment="OTA auto upgrade",.group=6,.len=7,.dot=3,.def="1",.bit=REVK_SETTINGS_BITFIELD_otaauto,.revk=1,.hide=1,.live=1},
 #ifdef	CONFIG_REVK_WEB_BETA
- {.type=REVK_SETTINGS_BIT,.name="otabeta",.comment="OTA from beta release",.group=5,.len=7,.dot=3,.bit=REVK_SETTINGS_BITFIELD_otabeta,.revk=1,.hide=1,.live=1},
+ {.type=REVK_SETTINGS_BIT,.name="otabeta",.comment="OTA from beta release",.group=6,.len=7,.dot=3,.bit=REVK_SETTINGS_BITFIELD_otabeta,.revk=1,.hide=1,.live=1},
 #endif
- {.type=REVK_SETTINGS_BLOB,.name="otacert",.comment="OTA cert of otahost",.group=5,.len=7,.dot=3,.dq=1,.def=quote(CONFIG_REVK_OTACERT),.ptr=&otacert,.malloc=1,.revk=1,.base64=1},
+ {.type=REVK_SETTINGS_BLOB,.name="otacert",.comment="OTA cert of otahost",.group=6,.len=7,.dot=3,.dq=1,.def=quote(CONFIG_REVK_OTACERT),.ptr=&otacert,.malloc=1,.revk=1,.base64=1},
  {.type=REVK_SETTINGS_STRING,.name="ntphost",.comment="NTP host",.len=7,.dq=1,.def=quote(CONFIG_REVK_NTPHOST),.ptr=&ntphost,.malloc=1,.revk=1},
  {.type=REVK_SETTINGS_STRING,.name="tz",.comment="Timezone (<a href='https://gist.github.com/alwynallan/24d96091655391107939' target=_blank>info</a>)",.len=2,.dq=1,.def=quote(CONFIG_REVK_TZ),.ptr=&tz,.malloc=1,.revk=1,.hide=1},
  {.type=REVK_SETTINGS_UNSIGNED,.name="watchdogtime",.comment="Watchdog (seconds)",.len=12,.dq=1,.def=quote(CONFIG_REVK_WATCHDOG),.ptr=&watchdogtime,.size=sizeof(uint32_t),.revk=1},
- {.type=REVK_SETTINGS_STRING,.name="topicgroup",.comment="MQTT Alternative hostname accepted for commands",.group=6,.len=10,.dot=5,.ptr=&topicgroup,.malloc=1,.revk=1,.array=2},
- {.type=REVK_SETTINGS_STRING,.name="topiccommand",.comment="MQTT Topic for commands",.group=6,.len=12,.dot=5,.def="command",.ptr=&topiccommand,.malloc=1,.revk=1,.old="prefixcommand"			},
- {.type=REVK_SETTINGS_STRING,.name="topicsetting",.comment="MQTT Topic for settings",.group=6,.len=12,.dot=5,.def="setting",.ptr=&topicsetting,.malloc=1,.revk=1,.old="prefixsetting"			},
- {.type=REVK_SETTINGS_STRING,.name="topicstate",.comment="MQTT Topic for state",.group=6,.len=10,.dot=5,.def="state",.ptr=&topicstate,.malloc=1,.revk=1,.old="prefixstate"			},
- {.type=REVK_SETTINGS_STRING,.name="topicevent",.comment="MQTT Topic for event",.group=6,.len=10,.dot=5,.def="event",.ptr=&topicevent,.malloc=1,.revk=1,.old="prefixevent"			},
- {.type=REVK_SETTINGS_STRING,.name="topicinfo",.comment="MQTT Topic for info",.group=6,.len=9,.dot=5,.def="info",.ptr=&topicinfo,.malloc=1,.revk=1,.old="prefixinfo"			},
- {.type=REVK_SETTINGS_STRING,.name="topicerror",.comment="MQTT Topic for error",.group=6,.len=10,.dot=5,.def="error",.ptr=&topicerror,.malloc=1,.revk=1,.old="prefixerror"			},
- {.type=REVK_SETTINGS_STRING,.name="topicha",.comment="MQTT Topic for homeassistant",.group=6,.len=7,.dot=5,.def="homeassistant",.ptr=&topicha,.malloc=1,.revk=1},
- {.type=REVK_SETTINGS_BIT,.name="prefixapp",.comment="MQTT use appname/ in front of hostname in topic",.group=7,.len=9,.dot=6,.dq=1,.def=quote(CONFIG_REVK_PREFIXAPP),.bit=REVK_SETTINGS_BITFIELD_prefixapp,.revk=1},
- {.type=REVK_SETTINGS_BIT,.name="prefixhost",.comment="MQTT use (appname/)hostname/topic instead of topic/(appname/)hostname",.group=7,.len=10,.dot=6,.dq=1,.def=quote(CONFIG_REVK_PREFIXHOST),.bit=REVK_SETTINGS_BITFIELD_prefixhost,.revk=1},
+ {.type=REVK_SETTINGS_STRING,.name="topicgroup",.comment="MQTT Alternative hostname accepted for commands",.group=7,.len=10,.dot=5,.ptr=&topicgroup,.malloc=1,.revk=1,.array=2},
+ {.type=REVK_SETTINGS_STRING,.name="topiccommand",.comment="MQTT Topic for commands",.group=7,.len=12,.dot=5,.def="command",.ptr=&topiccommand,.malloc=1,.revk=1,.old="prefixcommand"			},
+ {.type=REVK_SETTINGS_STRING,.name="topicsetting",.comment="MQTT Topic for settings",.group=7,.len=12,.dot=5,.def="setting",.ptr=&topicsetting,.malloc=1,.revk=1,.old="prefixsetting"			},
+ {.type=REVK_SETTINGS_STRING,.name="topicstate",.comment="MQTT Topic for state",.group=7,.len=10,.dot=5,.def="state",.ptr=&topicstate,.malloc=1,.revk=1,.old="prefixstate"			},
+ {.type=REVK_SETTINGS_STRING,.name="topicevent",.comment="MQTT Topic for event",.group=7,.len=10,.dot=5,.def="event",.ptr=&topicevent,.malloc=1,.revk=1,.old="prefixevent"			},
+ {.type=REVK_SETTINGS_STRING,.name="topicinfo",.comment="MQTT Topic for info",.group=7,.len=9,.dot=5,.def="info",.ptr=&topicinfo,.malloc=1,.revk=1,.old="prefixinfo"			},
+ {.type=REVK_SETTINGS_STRING,.name="topicerror",.comment="MQTT Topic for error",.group=7,.len=10,.dot=5,.def="error",.ptr=&topicerror,.malloc=1,.revk=1,.old="prefixerror"			},
+ {.type=REVK_SETTINGS_STRING,.name="topicha",.comment="MQTT Topic for homeassistant",.group=7,.len=7,.dot=5,.def="homeassistant",.ptr=&topicha,.malloc=1,.revk=1},
+ {.type=REVK_SETTINGS_BIT,.name="prefixapp",.comment="MQTT use appname/ in front of hostname in topic",.group=8,.len=9,.dot=6,.dq=1,.def=quote(CONFIG_REVK_PREFIXAPP),.bit=REVK_SETTINGS_BITFIELD_prefixapp,.revk=1},
+ {.type=REVK_SETTINGS_BIT,.name="prefixhost",.comment="MQTT use (appname/)hostname/topic instead of topic/(appname/)hostname",.group=8,.len=10,.dot=6,.dq=1,.def=quote(CONFIG_REVK_PREFIXHOST),.bit=REVK_SETTINGS_BITFIELD_prefixhost,.revk=1},
 #ifdef	CONFIG_REVK_BLINK_DEF
  {.type=REVK_SETTINGS_UNSIGNED,.gpio=1,.name="blink",.comment="R, G, B LED array (set all the same for WS2812 LED)",.len=5,.dq=1,.def=quote(CONFIG_REVK_BLINK),.ptr=&blink,.size=sizeof(revk_gpio_t),.fix=1,.set=1,.flags="- ~↓↕⇕",.revk=1,.array=3},
 #endif
@@ -80,53 +101,53 @@ revk_settings_t const revk_settings[]={
 #endif
 #ifdef  CONFIG_REVK_APMODE
 #ifdef	CONFIG_REVK_APCONFIG
- {.type=REVK_SETTINGS_UNSIGNED,.name="apport",.comment="TCP port for config web pages on AP",.group=8,.len=6,.dot=2,.dq=1,.def=quote(CONFIG_REVK_APPORT),.ptr=&apport,.size=sizeof(uint16_t),.revk=1},
+ {.type=REVK_SETTINGS_UNSIGNED,.name="apport",.comment="TCP port for config web pages on AP",.group=9,.len=6,.dot=2,.dq=1,.def=quote(CONFIG_REVK_APPORT),.ptr=&apport,.size=sizeof(uint16_t),.revk=1},
 #endif
- {.type=REVK_SETTINGS_UNSIGNED,.name="aptime",.comment="Limit AP to time (seconds)",.group=8,.len=6,.dot=2,.dq=1,.def=quote(CONFIG_REVK_APTIME),.ptr=&aptime,.size=sizeof(uint32_t),.revk=1},
- {.type=REVK_SETTINGS_UNSIGNED,.name="apwait",.comment="Wait off line before starting AP (seconds)",.group=8,.len=6,.dot=2,.dq=1,.def=quote(CONFIG_REVK_APWAIT),.ptr=&apwait,.size=sizeof(uint32_t),.revk=1},
- {.type=REVK_SETTINGS_UNSIGNED,.gpio=1,.name="apgpio",.comment="Start AP on GPIO",.group=8,.len=6,.dot=2,.dq=1,.def=quote(CONFIG_REVK_APGPIO),.ptr=&apgpio,.size=sizeof(revk_gpio_t),.fix=1,.set=1,.flags="- ~↓↕⇕",.revk=1},
+ {.type=REVK_SETTINGS_UNSIGNED,.name="aptime",.comment="Limit AP to time (seconds)",.group=9,.len=6,.dot=2,.dq=1,.def=quote(CONFIG_REVK_APTIME),.ptr=&aptime,.size=sizeof(uint32_t),.revk=1},
+ {.type=REVK_SETTINGS_UNSIGNED,.name="apwait",.comment="Wait off line before starting AP (seconds)",.group=9,.len=6,.dot=2,.dq=1,.def=quote(CONFIG_REVK_APWAIT),.ptr=&apwait,.size=sizeof(uint32_t),.revk=1},
+ {.type=REVK_SETTINGS_UNSIGNED,.gpio=1,.name="apgpio",.comment="Start AP on GPIO",.group=9,.len=6,.dot=2,.dq=1,.def=quote(CONFIG_REVK_APGPIO),.ptr=&apgpio,.size=sizeof(revk_gpio_t),.fix=1,.set=1,.flags="- ~↓↕⇕",.revk=1},
 #endif
 #ifdef  CONFIG_REVK_MQTT
- {.type=REVK_SETTINGS_STRING,.name="mqtthost",.comment="MQTT hostname",.group=9,.len=8,.dot=4,.dq=1,.def=quote(CONFIG_REVK_MQTTHOST),.ptr=&mqtthost,.malloc=1,.revk=1,.array=CONFIG_REVK_MQTT_CLIENTS,.hide=1},
- {.type=REVK_SETTINGS_UNSIGNED,.name="mqttport",.comment="MQTT port",.group=9,.len=8,.dot=4,.dq=1,.def=quote(CONFIG_REVK_MQTTPORT),.ptr=&mqttport,.size=sizeof(uint16_t),.revk=1,.array=CONFIG_REVK_MQTT_CLIENTS,.hide=1},
- {.type=REVK_SETTINGS_STRING,.name="mqttuser",.comment="MQTT username",.group=9,.len=8,.dot=4,.dq=1,.def=quote(CONFIG_REVK_MQTTUSER),.ptr=&mqttuser,.malloc=1,.revk=1,.array=CONFIG_REVK_MQTT_CLIENTS,.hide=1},
- {.type=REVK_SETTINGS_STRING,.name="mqttpass",.comment="MQTT password",.group=9,.len=8,.dot=4,.dq=1,.def=quote(CONFIG_REVK_MQTTPASS),.ptr=&mqttpass,.malloc=1,.revk=1,.array=CONFIG_REVK_MQTT_CLIENTS,.secret=1,.hide=1},
- {.type=REVK_SETTINGS_BLOB,.name="mqttcert",.comment="MQTT CA certificate",.group=9,.len=8,.dot=4,.dq=1,.def=quote(CONFIG_REVK_MQTTCERT),.ptr=&mqttcert,.malloc=1,.revk=1,.array=CONFIG_REVK_MQTT_CLIENTS,.base64=1},
-#endif
- {.type=REVK_SETTINGS_BLOB,.name="clientkey",.comment="Client Key (OTA and MQTT TLS)",.group=10,.len=9,.dot=6,.ptr=&clientkey,.malloc=1,.revk=1,.base64=1},
- {.type=REVK_SETTINGS_BLOB,.name="clientcert",.comment="Client certificate (OTA and MQTT TLS)",.group=10,.len=10,.dot=6,.ptr=&clientcert,.malloc=1,.revk=1,.base64=1},
+ {.type=REVK_SETTINGS_STRING,.name="mqtthost",.comment="MQTT hostname",.group=10,.len=8,.dot=4,.dq=1,.def=quote(CONFIG_REVK_MQTTHOST),.ptr=&mqtthost,.malloc=1,.revk=1,.array=CONFIG_REVK_MQTT_CLIENTS,.hide=1},
+ {.type=REVK_SETTINGS_UNSIGNED,.name="mqttport",.comment="MQTT port",.group=10,.len=8,.dot=4,.dq=1,.def=quote(CONFIG_REVK_MQTTPORT),.ptr=&mqttport,.size=sizeof(uint16_t),.revk=1,.array=CONFIG_REVK_MQTT_CLIENTS,.hide=1},
+ {.type=REVK_SETTINGS_STRING,.name="mqttuser",.comment="MQTT username",.group=10,.len=8,.dot=4,.dq=1,.def=quote(CONFIG_REVK_MQTTUSER),.ptr=&mqttuser,.malloc=1,.revk=1,.array=CONFIG_REVK_MQTT_CLIENTS,.hide=1},
+ {.type=REVK_SETTINGS_STRING,.name="mqttpass",.comment="MQTT password",.group=10,.len=8,.dot=4,.dq=1,.def=quote(CONFIG_REVK_MQTTPASS),.ptr=&mqttpass,.malloc=1,.revk=1,.array=CONFIG_REVK_MQTT_CLIENTS,.secret=1,.hide=1},
+ {.type=REVK_SETTINGS_BLOB,.name="mqttcert",.comment="MQTT CA certificate",.group=10,.len=8,.dot=4,.dq=1,.def=quote(CONFIG_REVK_MQTTCERT),.ptr=&mqttcert,.malloc=1,.revk=1,.array=CONFIG_REVK_MQTT_CLIENTS,.base64=1},
+#endif
+ {.type=REVK_SETTINGS_BLOB,.name="clientkey",.comment="Client Key (OTA and MQTT TLS)",.group=11,.len=9,.dot=6,.ptr=&clientkey,.malloc=1,.revk=1,.base64=1},
+ {.type=REVK_SETTINGS_BLOB,.name="clientcert",.comment="Client certificate (OTA and MQTT TLS)",.group=11,.len=10,.dot=6,.ptr=&clientcert,.malloc=1,.revk=1,.base64=1},
 #if     defined(CONFIG_REVK_WIFI) || defined(CONFIG_REVK_MESH)
- {.type=REVK_SETTINGS_UNSIGNED,.name="wifireset",.comment="Restart if WiFi off for this long (seconds)",.group=11,.len=9,.dot=4,.dq=1,.def=quote(CONFIG_REVK_WIFIRESET),.ptr=&wifireset,.size=sizeof(uint16_t),.revk=1,.hide=1},
- {.type=REVK_SETTINGS_STRING,.name="wifissid",.comment="WiFI SSID (name)",.group=11,.len=8,.dot=4,.dq=1,.def=quote(CONFIG_REVK_WIFISSID),.ptr=&wifissid,.malloc=1,.revk=1,.hide=1},
- {.type=REVK_SETTINGS_STRING,.name="wifipass",.comment="WiFi password",.group=11,.len=8,.dot=4,.dq=1,.def=quote(CONFIG_REVK_WIFIPASS),.ptr=&wifipass,.malloc=1,.revk=1,.hide=1,.secret=1},
- {.type=REVK_SETTINGS_STRING,.name="wifiip",.comment="WiFi Fixed IP",.group=11,.len=6,.dot=4,.dq=1,.def=quote(CONFIG_REVK_WIFIIP),.ptr=&wifiip,.malloc=1,.revk=1},
- {.type=REVK_SETTINGS_STRING,.name="wifigw",.comment="WiFi Fixed gateway",.group=11,.len=6,.dot=4,.dq=1,.def=quote(CONFIG_REVK_WIFIGW),.ptr=&wifigw,.malloc=1,.revk=1},
- {.type=REVK_SETTINGS_STRING,.name="wifidns",.comment="WiFi fixed DNS",.group=11,.len=7,.dot=4,.dq=1,.def=quote(CONFIG_REVK_WIFIDNS),.ptr=&wifidns,.malloc=1,.revk=1,.array=3},
- {.type=REVK_SETTINGS_OCTET,.name="wifibssid",.comment="WiFI BSSID",.group=11,.len=9,.dot=4,.dq=1,.def=quote(CONFIG_REVK_WIFIBSSID),.ptr=&wifibssid,.size=sizeof(uint8_t[6]),.revk=1,.hex=1},
- {.type=REVK_SETTINGS_UNSIGNED,.name="wifichan",.comment="WiFI channel",.group=11,.len=8,.dot=4,.dq=1,.def=quote(CONFIG_REVK_WIFICHAN),.ptr=&wifichan,.size=sizeof(uint8_t),.revk=1},
- {.type=REVK_SETTINGS_UNSIGNED,.name="wifiuptime",.comment="WiFI turns off after this many seconds",.group=11,.len=10,.dot=4,.dq=1,.def=quote(CONFIG_REVK_WIFIUPTIME),.ptr=&wifiuptime,.size=sizeof(uint16_t),.revk=1},
- {.type=REVK_SETTINGS_BIT,.name="wifips",.comment="WiFi power save",.group=11,.len=6,.dot=4,.dq=1,.def=quote(CONFIG_REVK_WIFIPS),.bit=REVK_SETTINGS_BITFIELD_wifips,.revk=1},
- {.type=REVK_SETTINGS_BIT,.name="wifimaxps",.comment="WiFi power save (max)",.group=11,.len=9,.dot=4,.dq=1,.def=quote(CONFIG_REVK_WIFIMAXPS),.bit=REVK_SETTINGS_BITFIELD_wifimaxps,.revk=1},
+ {.type=REVK_SETTINGS_UNSIGNED,.name="wifireset",.comment="Restart if WiFi off for this long (seconds)",.group=12,.len=9,.dot=4,.dq=1,.def=quote(CONFIG_REVK_WIFIRESET),.ptr=&wifireset,.size=sizeof(uint16_t),.revk=1,.hide=1},
+ {.type=REVK_SETTINGS_STRING,.name="wifissid",.comment="WiFI SSID (name)",.group=12,.len=8,.dot=4,.dq=1,.def=quote(CONFIG_REVK_WIFISSID),.ptr=&wifissid,.malloc=1,.revk=1,.hide=1},
+ {.type=REVK_SETTINGS_STRING,.name="wifipass",.comment="WiFi password",.group=12,.len=8,.dot=4,.dq=1,.def=quote(CONFIG_REVK_WIFIPASS),.ptr=&wifipass,.malloc=1,.revk=1,.hide=1,.secret=1},
+ {.type=REVK_SETTINGS_STRING,.name="wifiip",.comment="WiFi Fixed IP",.group=12,.len=6,.dot=4,.dq=1,.def=quote(CONFIG_REVK_WIFIIP),.ptr=&wifiip,.malloc=1,.revk=1},
+ {.type=REVK_SETTINGS_STRING,.name="wifigw",.comment="WiFi Fixed gateway",.group=12,.len=6,.dot=4,.dq=1,.def=quote(CONFIG_REVK_WIFIGW),.ptr=&wifigw,.malloc=1,.revk=1},
+ {.type=REVK_SETTINGS_STRING,.name="wifidns",.comment="WiFi fixed DNS",.group=12,.len=7,.dot=4,.dq=1,.def=quote(CONFIG_REVK_WIFIDNS),.ptr=&wifidns,.malloc=1,.revk=1,.array=3},
+ {.type=REVK_SETTINGS_OCTET,.name="wifibssid",.comment="WiFI BSSID",.group=12,.len=9,.dot=4,.dq=1,.def=quote(CONFIG_REVK_WIFIBSSID),.ptr=&wifibssid,.size=sizeof(uint8_t[6]),.revk=1,.hex=1},
+ {.type=REVK_SETTINGS_UNSIGNED,.name="wifichan",.comment="WiFI channel",.group=12,.len=8,.dot=4,.dq=1,.def=quote(CONFIG_REVK_WIFICHAN),.ptr=&wifichan,.size=sizeof(uint8_t),.revk=1},
+ {.type=REVK_SETTINGS_UNSIGNED,.name="wifiuptime",.comment="WiFI turns off after this many seconds",.group=12,.len=10,.dot=4,.dq=1,.def=quote(CONFIG_REVK_WIFIUPTIME),.ptr=&wifiuptime,.size=sizeof(uint16_t),.revk=1},
+ {.type=REVK_SETTINGS_BIT,.name="wifips",.comment="WiFi power save",.group=12,.len=6,.dot=4,.dq=1,.def=quote(CONFIG_REVK_WIFIPS),.bit=REVK_SETTINGS_BITFIELD_wifips,.revk=1},
+ {.type=REVK_SETTINGS_BIT,.name="wifimaxps",.comment="WiFi power save (max)",.group=12,.len=9,.dot=4,.dq=1,.def=quote(CONFIG_REVK_WIFIMAXPS),.bit=REVK_SETTINGS_BITFIELD_wifimaxps,.revk=1},
 #endif
 #ifndef	CONFIG_REVK_MESH
- {.type=REVK_SETTINGS_STRING,.name="apssid",.comment="AP mode SSID (name)",.group=8,.len=6,.dot=2,.dq=1,.def=quote(CONFIG_REVK_APSSID),.ptr=&apssid,.malloc=1,.revk=1},
- {.type=REVK_SETTINGS_STRING,.name="appass",.comment="AP mode password",.group=8,.len=6,.dot=2,.dq=1,.def=quote(CONFIG_REVK_APPASS),.ptr=&appass,.malloc=1,.revk=1,.secret=1},
- {.type=REVK_SETTINGS_UNSIGNED,.name="apmax",.comment="AP max clients",.group=8,.len=5,.dot=2,.dq=1,.def=quote(CONFIG_REVK_APMAX),.ptr=&apmax,.size=sizeof(uint8_t),.revk=1,.hide=1},
- {.type=REVK_SETTINGS_STRING,.name="apip",.comment="AP mode block",.group=8,.len=4,.dot=2,.dq=1,.def=quote(CONFIG_REVK_APIP),.ptr=&apip,.malloc=1,.revk=1},
- {.type=REVK_SETTINGS_BIT,.name="aplr",.comment="AP LR mode",.group=8,.len=4,.dot=2,.dq=1,.def=quote(CONFIG_REVK_APLR),.bit=REVK_SETTINGS_BITFIELD_aplr,.revk=1},
- {.type=REVK_SETTINGS_BIT,.name="aphide",.comment="AP hide SSID",.group=8,.len=6,.dot=2,.dq=1,.def=quote(CONFIG_REVK_APHIDE),.bit=REVK_SETTINGS_BITFIELD_aphide,.revk=1},
+ {.type=REVK_SETTINGS_STRING,.name="apssid",.comment="AP mode SSID (name)",.group=9,.len=6,.dot=2,.dq=1,.def=quote(CONFIG_REVK_APSSID),.ptr=&apssid,.malloc=1,.revk=1},
+ {.type=REVK_SETTINGS_STRING,.name="appass",.comment="AP mode password",.group=9,.len=6,.dot=2,.dq=1,.def=quote(CONFIG_REVK_APPASS),.ptr=&appass,.malloc=1,.revk=1,.secret=1},
+ {.type=REVK_SETTINGS_UNSIGNED,.name="apmax",.comment="AP max clients",.group=9,.len=5,.dot=2,.dq=1,.def=quote(CONFIG_REVK_APMAX),.ptr=&apmax,.size=sizeof(uint8_t),.revk=1,.hide=1},
+ {.type=REVK_SETTINGS_STRING,.name="apip",.comment="AP mode block",.group=9,.len=4,.dot=2,.dq=1,.def=quote(CONFIG_REVK_APIP),.ptr=&apip,.malloc=1,.revk=1},
+ {.type=REVK_SETTINGS_BIT,.name="aplr",.comment="AP LR mode",.group=9,.len=4,.dot=2,.dq=1,.def=quote(CONFIG_REVK_APLR),.bit=REVK_SETTINGS_BITFIELD_aplr,.revk=1},
+ {.type=REVK_SETTINGS_BIT,.name="aphide",.comment="AP hide SSID",.group=9,.len=6,.dot=2,.dq=1,.def=quote(CONFIG_REVK_APHIDE),.bit=REVK_SETTINGS_BITFIELD_aphide,.revk=1},
 #endif
 #ifdef	CONFIG_REVK_MESH
  {.type=REVK_SETTINGS_STRING,.name="nodename",.comment="Mesh node name",.len=8,.ptr=&nodename,.malloc=1,.revk=1,.hide=1},
- {.type=REVK_SETTINGS_UNSIGNED,.name="meshreset",.comment="Reset if mesh off for this long (seconds)",.group=12,.len=9,.dot=4,.dq=1,.def=quote(CONFIG_REVK_MESHRESET),.ptr=&meshreset,.size=sizeof(uint16_t),.revk=1,.hide=1},
- {.type=REVK_SETTINGS_OCTET,.name="meshid",.comment="Mesh ID (hex)",.group=12,.len=6,.dot=4,.dq=1,.def=quote(CONFIG_REVK_MESHID),.ptr=&meshid,.size=sizeof(uint8_t[6]),.revk=1,.hex=1,.hide=1},
- {.type=REVK_SETTINGS_OCTET,.name="meshkey",.comment="Mesh key",.group=12,.len=7,.dot=4,.ptr=&meshkey,.size=sizeof(uint8_t[16]),.revk=1,.secret=1,.hex=1,.hide=1},
- {.type=REVK_SETTINGS_UNSIGNED,.name="meshwidth",.comment="Mesh width",.group=12,.len=9,.dot=4,.dq=1,.def=quote(CONFIG_REVK_MESHWIDTH),.ptr=&meshwidth,.size=sizeof(uint16_t),.revk=1,.hide=1},
- {.type=REVK_SETTINGS_UNSIGNED,.name="meshdepth",.comment="Mesh depth",.group=12,.len=9,.dot=4,.dq=1,.def=quote(CONFIG_REVK_MESHDEPTH),.ptr=&meshdepth,.size=sizeof(uint16_t),.revk=1,.hide=1},
- {.type=REVK_SETTINGS_UNSIGNED,.name="meshmax",.comment="Mesh max devices",.group=12,.len=7,.dot=4,.dq=1,.def=quote(CONFIG_REVK_MESHMAX),.ptr=&meshmax,.size=sizeof(uint16_t),.revk=1,.hide=1},
- {.type=REVK_SETTINGS_STRING,.name="meshpass",.comment="Mesh AP password",.group=12,.len=8,.dot=4,.dq=1,.def=quote(CONFIG_REVK_MESHPASS),.ptr=&meshpass,.malloc=1,.revk=1,.secret=1,.hide=1},
- {.type=REVK_SETTINGS_BIT,.name="meshlr",.comment="Mesh use LR mode",.group=12,.len=6,.dot=4,.dq=1,.def=quote(CONFIG_REVK_MESHLR),.bit=REVK_SETTINGS_BITFIELD_meshlr,.revk=1,.hide=1},
- {.type=REVK_SETTINGS_BIT,.name="meshroot",.comment="This is preferred mesh root",.group=12,.len=8,.dot=4,.bit=REVK_SETTINGS_BITFIELD_meshroot,.revk=1,.hide=1},
+ {.type=REVK_SETTINGS_UNSIGNED,.name="meshreset",.comment="Reset if mesh off for this long (seconds)",.group=13,.len=9,.dot=4,.dq=1,.def=quote(CONFIG_REVK_MESHRESET),.ptr=&meshreset,.size=sizeof(uint16_t),.revk=1,.hide=1},
+ {.type=REVK_SETTINGS_OCTET,.name="meshid",.comment="Mesh ID (hex)",.group=13,.len=6,.dot=4,.dq=1,.def=quote(CONFIG_REVK_MESHID),.ptr=&meshid,.size=sizeof(uint8_t[6]),.revk=1,.hex=1,.hide=1},
+ {.type=REVK_SETTINGS_OCTET,.name="meshkey",.comment="Mesh key",.group=13,.len=7,.dot=4,.ptr=&meshkey,.size=sizeof(uint8_t[16]),.revk=1,.secret=1,.hex=1,.hide=1},
+ {.type=REVK_SETTINGS_UNSIGNED,.name="meshwidth",.comment="Mesh width",.group=13,.len=9,.dot=4,.dq=1,.def=quote(CONFIG_REVK_MESHWIDTH),.ptr=&meshwidth,.size=sizeof(uint16_t),.revk=1,.hide=1},
+ {.type=REVK_SETTINGS_UNSIGNED,.name="meshdepth",.comment="Mesh depth",.group=13,.len=9,.dot=4,.dq=1,.def=quote(CONFIG_REVK_MESHDEPTH),.ptr=&meshdepth,.size=sizeof(uint16_t),.revk=1,.hide=1},
+ {.type=REVK_SETTINGS_UNSIGNED,.name="meshmax",.comment="Mesh max devices",.group=13,.len=7,.dot=4,.dq=1,.def=quote(CONFIG_REVK_MESHMAX),.ptr=&meshmax,.size=sizeof(uint16_t),.revk=1,.hide=1},
+ {.type=REVK_SETTINGS_STRING,.name="meshpass",.comment="Mesh AP password",.group=13,.len=8,.dot=4,.dq=1,.def=quote(CONFIG_REVK_MESHPASS),.ptr=&meshpass,.malloc=1,.revk=1,.secret=1,.hide=1},
+ {.type=REVK_SETTINGS_BIT,.name="meshlr",.comment="Mesh use LR mode",.group=13,.len=6,.dot=4,.dq=1,.def=quote(CONFIG_REVK_MESHLR),.bit=REVK_SETTINGS_BITFIELD_meshlr,.revk=1,.hide=1},
+ {.type=REVK_SETTINGS_BIT,.name="meshroot",.comment="This is preferred mesh root",.group=13,.len=8,.dot=4,.bit=REVK_SETTINGS_BITFIELD_meshroot,.revk=1,.hide=1},
 #endif
 {0}};
 #undef quote
@@ -148,14 +169,28 @@ uint16_t port=0;
 uint16_t baud=0;
 uint8_t databits=0;
 uint8_t stop=0;
+uint8_t oversample=0;
 uint8_t linelen=0;
+uint32_t txbuf=0;
+uint16_t rxbuf=0;
 uint16_t timecr=0;
+uint16_t timelf=0;
+uint16_t timebel=0;
+uint16_t timetab=0;
+uint16_t timedc2=0;
 uint16_t timepwron=0;
 uint16_t timemtron=0;
 uint16_t timemtroff=0;
 uint16_t timepwroff=0;
 uint32_t timeremidle=0;
 uint32_t timekeyidle=0;
+uint16_t timeflush=0;
+revk_gpio_t ttytx[3]={0};
+revk_gpio_t ttyrx[3]={0};
+uint16_t ttyport[3]={0};
+uint16_t ttybaud[3]={0};
+uint8_t ttydatabits[3]={0};
+uint8_t ttystop[3]={0};
 #ifdef	CONFIG_REVK_SETTINGS_PASSWORD
 char* password=NULL;
 #endif
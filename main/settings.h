@@ -60,6 +60,13 @@ enum {
  REVK_SETTINGS_BITFIELD_autocave,
  REVK_SETTINGS_BITFIELD_autoon,
  REVK_SETTINGS_BITFIELD_autoprompt,
+ REVK_SETTINGS_BITFIELD_telnet,
+ REVK_SETTINGS_BITFIELD_linemode,
+ REVK_SETTINGS_BITFIELD_tcpnodelay,
+ REVK_SETTINGS_BITFIELD_txpsram,
+ REVK_SETTINGS_BITFIELD_ita2,
+ REVK_SETTINGS_BITFIELD_rxedge,
+ REVK_SETTINGS_BITFIELD_autobaud,
 #ifdef	CONFIG_REVK_SETTINGS_PASSWORD
 #endif
  REVK_SETTINGS_BITFIELD_otaauto,
@@ -103,6 +110,13 @@ struct revk_settings_bits_s {
  uint8_t autocave:1;	// Auto start colossal cave
  uint8_t autoon:1;	// Auto power on
  uint8_t autoprompt:1;	// Auto prompt
+ uint8_t telnet:1;	// Telnet on TCP port, with RFC 2217 com port control
+ uint8_t linemode:1;	// Gather typed characters to end of line for TCP, and telnet line at a time
+ uint8_t tcpnodelay:1;	// TCP_NODELAY, no Nagle, send TCP segments at once
+ uint8_t txpsram:1;	// Tx buffer in PSRAM (if fitted)
+ uint8_t ita2:1;	// Translate ASCII to and from 5 bit Baudot (ITA2)
+ uint8_t rxedge:1;	// Soft UART rx by edge interrupt and decoder task, not timer sampling
+ uint8_t autobaud:1;	// Auto-baud on rx (rxedge only), 45.45/50/56.88/74.2/110
 #ifdef	CONFIG_REVK_SETTINGS_PASSWORD
 #endif
  uint8_t otaauto:1;	// OTA auto upgrade
@@ -158,17 +172,38 @@ extern char* autoconnect;	// Auto connect to host
 extern uint8_t tapelead;	// Tape lead NULLs
 extern uint8_t tapetail;	// Tape tail NULLs
 extern uint16_t port;	// TCP port
+#define	telnet	revk_settings_bits.telnet
+#define	linemode	revk_settings_bits.linemode
+#define	tcpnodelay	revk_settings_bits.tcpnodelay
 extern uint16_t baud;	// Baud rate
 extern uint8_t databits;	// Data bits
-extern uint8_t stop;	// Stop bits (multiples of 0.5 bits)
+extern uint8_t stop;	// Stop bits
+extern uint8_t oversample;	// Soft UART interrupts per bit (5, 8, or 16)
 extern uint8_t linelen;	// Line length characters
+extern uint32_t txbuf;	// Tx buffer size (bytes)
+extern uint16_t rxbuf;	// Rx buffer size (bytes)
+#define	txpsram	revk_settings_bits.txpsram
+#define	ita2	revk_settings_bits.ita2
+#define	rxedge	revk_settings_bits.rxedge
+#define	autobaud	revk_settings_bits.autobaud
 extern uint16_t timecr;	// Time for CR (s) for whole line
+extern uint16_t timelf;	// Time for LF (s)
+extern uint16_t timebel;	// Time for BEL (s)
+extern uint16_t timetab;	// Time for TAB (s)
+extern uint16_t timedc2;	// Time for DC2 (s), punch on, holds all tx
 extern uint16_t timepwron;	// Time for power on
 extern uint16_t timemtron;	// Time for motor on
 extern uint16_t timemtroff;	// Time for motor off
 extern uint16_t timepwroff;	// Time for power off
 extern uint32_t timeremidle;	// Idle time at end of remote
 extern uint32_t timekeyidle;	// Idle time at end of manual working
+extern uint16_t timeflush;	// Time to gather rx in to one TCP send (s)
+extern revk_gpio_t ttytx[3];	// Extra line Tx
+extern revk_gpio_t ttyrx[3];	// Extra line Rx
+extern uint16_t ttyport[3];	// Extra line TCP port
+extern uint16_t ttybaud[3];	// Extra line baud rate (0 for baud)
+extern uint8_t ttydatabits[3];	// Extra line data bits (0 for databits)
+extern uint8_t ttystop[3];	// Extra line stop bits (0 for stop)
 #ifdef	CONFIG_REVK_SETTINGS_PASSWORD
 extern char* password;	// Settings password (this is not sent securely so use with care on local networks you control)
 #endif
@@ -274,12 +309,19 @@ enum {
 #define	baud_scale	100
 #define	stop_scale	10
 #define	timecr_scale	1000
+#define	timelf_scale	1000
+#define	timebel_scale	1000
+#define	timetab_scale	1000
+#define	timedc2_scale	1000
 #define	timepwron_scale	1000
 #define	timemtron_scale	1000
 #define	timemtroff_scale	1000
 #define	timepwroff_scale	1000
 #define	timeremidle_scale	1000
 #define	timekeyidle_scale	1000
-typedef uint8_t revk_setting_bits_t[13];
+#define	timeflush_scale	1000
+#define	ttybaud_scale	100
+#define	ttystop_scale	10
+typedef uint8_t revk_setting_bits_t[15];
 typedef uint8_t revk_setting_group_t[2];
 extern const char revk_settings_secret[];
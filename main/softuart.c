@@ -1,11 +1,28 @@
 // Simple soft UART for slow speed duplex UART operation, e.g. 110 Baud, with break detect
 // Copyright © 2022 Adrian Kennard, Andrews & Arnold Ltd. See LICENCE file for details. GPL 3.0
 //
-// This works on a timer interrupt at 5 x bit rate
+// This works on a timer interrupt at 5, 8, or 16 x bit rate (steps), with a separate handler for each steps and rx method, as constants
+// Each tx byte is made in to a frame of line levels (start, data, stop, inversion applied) when started, so each bit is just a shift
 // Start bit accepted after 2 samples low
-// Receive sample by middle 3 samples majority in each bit
-// Would be nice some time to have some stats for bad start bits, and bad quality bits (e.g. 1 or 2 counts not 0 or 3)
+// Receive sample by majority of the steps-1 samples counted in each bit
+// Stats for bad start/stop bits, and bad quality bits (samples not all the same)
+// Alternatively (rxedge) rx is by a GPIO edge interrupt logging edge times, decoded by a task, so no rx work per tick
+// The edge decoder integrates the time the line is high in each bit, so quality is measured to the us not to the tick
+// Tick period is a phase accumulator, alternating the timer alarm between n and n+1 counts, so exact on average for any baud rate
+// Stop bits are similarly a Q8 fraction of ticks, accumulated per character, so e.g. 1.5 stop bits is exact on average
+// Mechanical timing: CR waits in proportion to carriage position, other control characters can have a fixed hold (softuart_hold)
+// The wait only delays printable characters, or all characters for a hold set as such (e.g. DC2 engaging the punch)
+// Tx ring is lock free for several writers: space is reserved by compare and swap on txres, then committed to txi in order
+// A tx byte can be repeated, e.g. tape leader NULs, by a descriptor giving its slot in the tx ring and count, expanded by the interrupt
+// Rx ring is lock free for one reader, the interrupt (or edge task) being the one writer
+// The edge decoder fits each character's bit period to where its edges fall, and can auto-baud by fitting rate and bias to pulse lengths
+// It also meters the sender's speed error, bias and peak distortion, and stop length, as averages for adjusting the machine
+// Each rx byte has the time of its stop bit (low 32 bits of esp_timer_get_time), widened to 64 bits by the reader
+// Several ports can share a timer (and its one interrupt), which ticks at the fastest port's rate, slower ports on a phase accumulator
+// The timer is paused when tx and rx are idle on all its ports, and restarted on tx (queue, break, xon) or rx start edge, first tick half a tick later
+// A task can be notified on rx byte, rx break start or end, and tx drained (softuart_notify), so a caller can block rather than poll
 
+#ifndef	SOFTUART_BENCH          // softuartbench.c supplies a simulated GPIO/timer environment to run this on a host
 #include "revk.h"
 #include "softuart.h"
 #include "esp_log.h"
@@ -15,51 +32,163 @@
 #include "soc/gpio_reg.h"
 #include <driver/timer.h>
 #include <driver/gpio.h>
+#include "freertos/task.h"
+#endif
+#include <stdatomic.h>
 #define TIMER_BASE_CLK   (APB_CLK_FREQ)
 
-#define	STEPS	5               // Interrupts per clock
+#define	EDGES	64              // Rx edge ring size, power of 2
+#define	RXE	16              // Rx edges logged in one character
+#define	PULSES	24              // Rx pulses looked at for auto-baud
+#define	PRI	16              // Priority tx ring size, power of 2
+#define	REPS	16              // Tx repeat descriptor ring size, power of 2
+#define	DIVIDER	2               // Timer clock divider, min 2
+#define	TIMERS	2               // Timers in group 0
+
+#define	TICK_WOKEN	1       // Port tick handler woke a task
+#define	TICK_QUIET	2       // Port tick handler has nothing to do, so far as it knows
+
+static const uint16_t autobauds[] = { 4545, 5000, 5688, 7420, 11000 };  // Rates for auto-baud (x100)
+#define	AUTOBAUDS	(sizeof (autobauds) / sizeof (*autobauds))
+
+typedef struct softuart_timer_s softuart_timer_t;
+struct softuart_timer_s
+{                               // A hardware timer, shared by the ports on it, ticking at the rate of the fastest
+   portMUX_TYPE lock;           // Protect idle, rate, and ports
+   volatile uint8_t idle;       // Timer paused as nothing to do
+   uint8_t rearm;               // Alarm to be set to a whole tick, after a restart with a half tick, or a rate change
+   uint32_t ticks;              // Timer counts per tick (whole part)
+   uint16_t tickfrac;           // Timer counts per tick (fractional part, /65536)
+   uint16_t tickacc;            // Tick phase accumulator
+   uint8_t tickextra;           // Alarm is currently ticks+1
+   int8_t timer;                // Which timer
+   uint8_t started:1;           // Int handler started
+   softuart_t *ports;           // Ports on this timer
+};
+static softuart_timer_t timers[TIMERS] = { 0 };
 
 struct softuart_s
 {
-   SemaphoreHandle_t mutex;     // Protect softuart_tx
+   SemaphoreHandle_t txsem;     // Given by int when a tx byte is taken, or tx drained, and txwaiters set
+   SemaphoreHandle_t rxsem;     // Given by int when a rx byte is stored and rxblock set
+   _Atomic uint8_t txwaiters;   // Writers waiting for tx space, or for tx to drain
+   _Atomic uint8_t rxblock;     // Set by softuart_rx when waiting for data, cleared by int (seq_cst with rxi, as each side stores one and loads the other)
+   TaskHandle_t notify;         // Task notified on rx byte, rx break start or end, and tx drained (softuart_notify)
+   uint8_t txdrain;             // Tx has sent since last drained, set and cleared by int
+   volatile uint32_t txwant;    // Tx space to notify at (softuart_tx_notify), cleared by int
 
+   portMUX_TYPE lock;           // Protect priority tx writers
+   softuart_timer_t *t;         // Timer this port is on
+   softuart_t *next;            // Next port on same timer
+   uint32_t ticks;              // Timer counts per tick for this port (whole part)
+   uint16_t tickfrac;           // Timer counts per tick for this port (fractional part, /65536)
+   uint32_t step;               // Ticks of this port per timer tick (/65536), the fastest port on the timer is every tick
+   uint32_t phase;              // Phase accumulator for step
+   uint8_t quiet;               // Nothing to do as of this port's last tick
    uint16_t baudx100;           // Baud rate, x 100
-   int8_t timer;                // Which timer
-   int8_t stops;                // Stop bits in interrupts
+   uint16_t stops;              // Stop bits in interrupts (Q8)
+   uint8_t stopacc;             // Stop bits fractional accumulator (Q8)
+   uint8_t stopx10;             // Stop bits (x10) as set
+   _Atomic uint16_t fmt;        // Format for int to apply between characters, bits << 8 | stopx10 (either 0 to leave as is), 0 if none
+   uint8_t steps;               // Interrupts per bit
+   uint8_t (*tick) (softuart_t *);      // Tick handler specialised for steps and rx by edge
    uint8_t bits:4;              // Bits
    uint8_t txinv:1;             // Invert tx
    uint8_t rxinv:1;             // Invert rx
-   uint8_t started:1;           // Int handler started
+   uint8_t started:1;           // Port started
    uint8_t txwait:1;            // Hold off on tx
+   uint8_t psram:1;             // txdata is in PSRAM
+   uint8_t rxbyedge:1;          // Rx by edge interrupt and decoder task, not sampled on timer ticks
 
    int8_t tx;                   // Tx GPIO
-   uint8_t txdata[32768];       // The tx message
-   volatile uint16_t txi;       // Next byte to which new tx byte to be written (set by non int)
-   volatile uint16_t txo;       // Next byte from which a tx byte will be read (set by int)
-   uint16_t crwait;             // Tx waiting for CR (sub bit count down)
+   uint8_t *txdata;             // The tx message (may be in PSRAM)
+   uint32_t txsize;             // Size of txdata
+   _Atomic uint32_t txres;      // Next byte to be reserved by a writer (set by non int)
+   _Atomic uint32_t txi;        // Next byte to which new tx byte to be written, i.e. end of committed bytes (set by non int)
+   _Atomic uint32_t txo;        // Next byte from which a tx byte will be read (set by int)
+   struct
+   {
+      uint32_t slot;            // Slot in txdata of byte to repeat
+      uint16_t count;           // Times to send it
+   } rep[REPS];                 // Tx repeat descriptors, in slot order
+   _Atomic uint8_t repi;        // Next descriptor to be written (set by non int, by the writer committing)
+   _Atomic uint8_t repo;        // Next descriptor to be read (set by int)
+   uint16_t txrepn;             // Repeats left of the byte at txo
+   uint8_t pri[PRI];            // Priority tx bytes, sent ahead of txdata
+   volatile uint8_t prii;       // Next byte to which new priority byte to be written (set by non int)
+   volatile uint8_t prio;       // Next byte from which a priority byte will be read (set by int)
+   uint8_t prion;               // Control character after which priority bytes do not go ahead of txdata (e.g. DC2, punch on)
+   uint8_t prioff;              // Control character that ends that (e.g. DC4, punch off)
+   uint8_t priblock;            // Priority bytes after txdata, as prion sent (set by int)
+   uint16_t crwait;             // Tx waiting before printable, for CR or a hold (sub bit count down)
    uint16_t crline;             // Tx wait extra sub bits for whole line
+   uint16_t crms;               // Tx wait for whole line (ms) as set, crline is from this for the baud rate
+   uint16_t allwait;            // Tx waiting before any byte (sub bit count down)
+   uint16_t hold[32];           // Tx wait after each control character (sub bits)
+   uint16_t holdms[32];         // Tx wait after each control character (ms) as set, hold is from this for the baud rate
+   uint32_t holdall;            // Control characters whose hold is for all bytes, not just printable
    uint8_t txbit;               // Tx bit count, 0 means idle
    volatile uint8_t txsubbit;   // Tx sub bit count
-   uint8_t txbyte;              // Tx byte being clocked in
+   uint16_t txframe;            // Tx line levels still to send for this byte, LSB first, data then stop, inversion applied
+   uint16_t txfdata;            // Tx frame data bits mask (after start bit)
+   uint16_t txfxor;             // Tx frame stop bit, and inversion if txinv, applied to start and data
+   uint16_t charsub;            // Sub bits for a whole character, start, data, and whole stop bits
    volatile uint8_t txbreak;    // Tx break (chars to send)
    uint8_t linelen;             // Line len
    uint8_t pos;                 // Carriage posn
 
    int8_t rx;                   // Rx pin (can be same as tx)
-   uint8_t rxdata[32];          // The Rx data
-   volatile uint16_t rxi;       // Next byte to which new rx byte to be written (set by int)
-   volatile uint16_t rxo;       // Next byte from which a rx byte will be read (set by non int)
+   uint8_t *rxdata;             // The Rx data (internal RAM)
+   uint32_t *rxts;              // The Rx byte timestamps (us, internal RAM), same slots as rxdata
+   uint16_t rxsize;             // Size of rxdata
+   _Atomic uint16_t rxi;        // Next byte to which new rx byte to be written (set by int)
+   _Atomic uint16_t rxo;        // Next byte from which a rx byte will be read (set by non int)
    uint8_t rxbit;               // Rx bit count, 0 means idle
    uint8_t rxsubbit;            // Rx sub bit count
    uint8_t rxcount;             // Rx sub bit 1 count
    uint8_t rxbyte;              // Rx byte being clocked in
    volatile uint8_t rxbreak;    // Rx break (bit count up to max)
 
+   TaskHandle_t rxtask;         // Rx edge decoder task
+   _Atomic uint16_t rxbaud;     // Baud rate (x100) for the rx edge decoder task to apply, 0 if none
+   volatile uint32_t edge[EDGES];       // Rx edge times (us), bit 0 is the line level after the edge
+   volatile uint8_t edgei;      // Next edge to be written (set by int)
+   volatile uint8_t edgeo;      // Next edge to be read (set by task)
+   uint32_t rxbitus;            // Rx bit time (us), tracking the sender
+   uint32_t rxbitnom;           // Rx bit time (us) for the baud rate set
+   uint32_t rxcbit;             // Rx bit time (us) for this character, from its edges so far
+   uint8_t rxgood;              // Rx good characters since baud rate set (up to 16), tracking trusted more as this goes up
+   uint8_t rxmiss;              // Rx edges in this character well away from a bit boundary in the fit
+   uint32_t rxpulse[PULSES];    // Auto-baud pulse lengths (us), bit 0 is the line level during the pulse
+   uint8_t rxgaps;              // Auto-baud number of pulses in rxpulse
+   uint32_t rxt0;               // Rx start bit edge time, or break start (us)
+   uint32_t rxlastt;            // Rx time of last edge processed (us)
+   uint32_t rxe[RXE];           // Rx edges in this character, time after start bit edge (us), bit 0 is the line level after the edge
+   uint8_t rxn;                 // Rx edges in rxe
+   uint8_t rxlevel;             // Rx line level after last edge processed
+   uint8_t rxauto:1;            // Auto-baud, hunt for baud rate at start and after a long break
+   uint8_t rxhunt:1;            // Auto-baud hunting
+   uint8_t rxsync:1;            // Wait for line idle before looking for a start bit
+   uint8_t mstopok:1;           // Meter, mstopt is the start of the stop bit after a good character
+
+   // Meter, running averages, in 1/65536 of a bit (rxedge)
+   int32_t mspeed;              // Sender speed error, positive is fast
+   int32_t mrise;               // Rising edge (space to mark) offset from where it should be
+   int32_t mfall;               // Falling edge (mark to space) offset from where it should be
+   int32_t mpeak;               // Largest edge offset in each character
+   int32_t mstop;               // Stop length when sending continuously
+   uint32_t mn,                 // Number of characters metered
+     mrisen,                    // Number of rising edges metered
+     mfalln,                    // Number of falling edges metered
+     mstopn;                    // Number of stop bits metered
+   uint32_t mstopt;             // Start of stop bit of last good character (us)
+   uint32_t mstopbit;           // Bit time (us) of last good character
+
    softuart_stats_t stats;
 
      uint8_t:0;                 //      Bits set from int
    uint8_t rxlast:1;            // Last rx bit
-   uint8_t txnext:1;            // Next tx bit
+   uint8_t txline:1;            // Tx line level to set on next tick (inverted if txinv)
 };
 
 uint8_t
@@ -72,18 +201,212 @@ pe (uint8_t b)
    return b;
 }
 
+#ifndef	SOFTUART_BENCH
 // Low level direct GPIO controls - inlines were not playing with some optimisation modes
 #define gpio_set(r) do{if ((r) >= 32)GPIO_REG_WRITE(GPIO_OUT1_W1TS_REG, 1 << ((r) - 32)); else if ((r) >= 0)GPIO_REG_WRITE(GPIO_OUT_W1TS_REG, 1 << (r));}while(0)
 #define gpio_clr(r) do{if ((r) >= 32)GPIO_REG_WRITE(GPIO_OUT1_W1TC_REG, 1 << ((r) - 32));else if ((r) >= 0)GPIO_REG_WRITE(GPIO_OUT_W1TC_REG, 1 << (r));}while(0)
 #define gpio_get(r) (((r) >= 32)?((GPIO_REG_READ(GPIO_IN1_REG) >> ((r) - 32)) & 1):((r) >= 0)?((GPIO_REG_READ(GPIO_IN_REG) >> (r)) & 1):0)
+#endif
 
-bool IRAM_ATTR
-timer_isr (void *up)
-{
-   softuart_t *u = up;
-   // Timing based, sample Rx and set Tx
-   uint8_t r = (gpio_get (u->rx) ^ u->rxinv);
-   if (u->txnext ^ u->txinv)
+static inline __attribute__((always_inline)) bool
+rx_latch (softuart_t * u, uint8_t byte, uint32_t ts)
+{                               // Store a received byte (clean start and stop bit) and its time, returns true if the reader needs waking
+   uint16_t rxi = atomic_load_explicit (&u->rxi, memory_order_relaxed);
+   if (byte != pe (byte))
+      u->stats.rxbadp++;
+   u->rxdata[rxi] = byte;
+   u->rxts[rxi] = ts;
+   rxi++;
+   if (rxi == u->rxsize)
+      rxi = 0;
+   uint16_t rxo = atomic_load_explicit (&u->rxo, memory_order_acquire);
+   if (rxi != rxo)
+   {
+      atomic_store_explicit (&u->rxi, rxi, memory_order_seq_cst);       // Has space, byte visible to reader, before rxblock is checked
+      uint16_t n = (rxi >= rxo ? rxi - rxo : rxi + u->rxsize - rxo);
+      if (n > u->stats.rxhigh)
+         u->stats.rxhigh = n;
+   } else
+      u->stats.rxoverrun++;     // No space, byte lost
+   u->stats.rx++;
+   if (!atomic_load_explicit (&u->rxblock, memory_order_seq_cst))
+      return 0;
+   atomic_store_explicit (&u->rxblock, 0, memory_order_relaxed);        // Reader waiting for data
+   return 1;
+}
+
+static inline __attribute__((always_inline)) uint8_t
+port_idle (softuart_t * u)
+{                               // Port has nothing to do, checked with timer lock held
+   return (u->txwait || (atomic_load (&u->txi) == atomic_load (&u->txo) && u->prii == u->prio)) && (u->rxbyedge
+                                                                                                   || (gpio_get (u->rx) ^ u->rxinv));
+}
+
+static inline __attribute__((always_inline)) void
+tick_idle (softuart_timer_t * t)
+{                               // Pause the timer, all ports having been quiet on their last tick
+   portENTER_CRITICAL_ISR (&t->lock);
+   softuart_t *u = t->ports;
+   while (u && port_idle (u))
+      u = u->next;
+   if (!u)
+   {                            // Checked under lock as tick_wake must see idle set, and rx checked again for an edge since sampled
+      uint64_t c = timer_group_get_counter_value_in_isr (0, t->timer);
+      timer_group_set_alarm_value_in_isr (0, t->timer, c + t->ticks / 2);       // Restart half a tick from this point
+      timer_group_set_counter_enable_in_isr (0, t->timer, TIMER_PAUSE);
+      t->rearm = 1;
+      t->idle = 1;
+   }
+   portEXIT_CRITICAL_ISR (&t->lock);
+}
+
+static inline __attribute__((always_inline)) void
+tick_wake (softuart_t * u)
+{                               // Restart the timer if paused, from task or interrupt
+   softuart_timer_t *t = u->t;
+   portENTER_CRITICAL_SAFE (&t->lock);
+   if (t->idle)
+   {
+      t->idle = 0;
+      timer_group_set_counter_enable_in_isr (0, t->timer, TIMER_START);
+   }
+   portEXIT_CRITICAL_SAFE (&t->lock);
+}
+
+static bool IRAM_ATTR
+tx_next (softuart_t * u)
+{                               // Tx at end of a character, start the next one, or break, or idle, returns true if a task is woken
+   // Once per character, so not inlined in to each specialised handler
+   BaseType_t woken = pdFALSE;
+   uint32_t txi = atomic_load_explicit (&u->txi, memory_order_acquire);
+   uint32_t txo = atomic_load_explicit (&u->txo, memory_order_relaxed);
+   if (u->txline == u->txinv)
+   {                            // End of a break character
+      if (u->txbreak)
+         u->txbreak--;          // More break
+      else
+         u->txline = !u->txinv; // Idle
+      u->txsubbit = u->charsub; // Whole char
+   } else if (txi != txo || u->prii != u->prio)
+   {                            // We have a byte, priority bytes first
+      uint8_t prio = u->prio;
+      uint8_t pri = (u->prii != prio && (!u->priblock || txi == txo));      // Not ahead of txdata while punching
+      uint8_t c = (pri ? u->pri[prio] : u->txdata[txo]);
+      uint8_t b = (c & 0x7F);
+      if (!u->crwait || b < ' ' || b >= 0x7F)
+      {                         // Either Ok to send not (CR time done) or non printable, so OK to send anyway
+         if (u->prion && b == u->prion)
+            u->priblock = 1;
+         else if (u->prion && b == u->prioff)
+            u->priblock = 0;
+         if (pri)
+         {
+            u->prio = ((prio + 1) & (PRI - 1));
+            if (atomic_load_explicit (&u->txwaiters, memory_order_acquire))
+               xSemaphoreGiveFromISR (u->txsem, &woken);        // Priority writer waiting for space
+         } else
+         {
+            uint8_t repo = atomic_load_explicit (&u->repo, memory_order_relaxed);
+            if (repo != atomic_load_explicit (&u->repi, memory_order_acquire) && u->rep[repo].slot == txo)
+            {                   // Repeated byte, stays at txo until all sent
+               if (!u->txrepn)
+                  u->txrepn = u->rep[repo].count;
+               if (!--u->txrepn)
+                  atomic_store_explicit (&u->repo, (repo + 1) & (REPS - 1), memory_order_release);
+            }
+            if (!u->txrepn)
+            {
+               txo++;
+               if (txo == u->txsize)
+                  txo = 0;
+               atomic_store_explicit (&u->txo, txo, memory_order_release);
+               if (atomic_load_explicit (&u->txwaiters, memory_order_acquire))
+                  xSemaphoreGiveFromISR (u->txsem, &woken);     // Writer waiting for space
+               if (u->txwant)
+               {                // Reader of a source (e.g. TCP) waiting for space
+                  int space = (int) txo - (int) txi - 1;
+                  if (space < 0)
+                     space += u->txsize;
+                  if ((uint32_t) space >= u->txwant)
+                  {
+                     u->txwant = 0;
+                     if (u->notify)
+                        vTaskNotifyGiveFromISR (u->notify, &woken);
+                  }
+               }
+            }
+         }
+         uint16_t frame = ((((uint16_t) c << 1) & u->txfdata) ^ u->txfxor);    // Line levels, start, data, stop
+         u->txline = (frame & 1);       // Start bit
+         u->txframe = (frame >> 1);
+         u->txbit = u->bits + 1;
+         u->txsubbit = u->steps;
+         if (b == '\r')
+         {                      // CR
+            if (!u->crwait)
+               u->crwait = (int) u->pos * u->crline / u->linelen + u->charsub;    // Allow extra time for CR
+            u->pos = 0;
+         } else if (b >= ' ' && b < 0x7F)
+         {
+            if (u->pos < u->linelen)
+               u->pos++;
+         } else if (b < ' ' && u->hold[b])
+         {                      // Control character with mechanical hold
+            uint16_t w = u->hold[b] + u->charsub;
+            if (u->holdall & (1 << b))
+            {
+               if (w > u->allwait)
+                  u->allwait = w;
+            } else if (w > u->crwait)
+               u->crwait = w;
+         }
+         u->stats.tx++;
+         u->txdrain = 1;
+      }
+   } else if (u->txbreak)
+   {
+      u->txbreak--;
+      u->txsubbit = u->charsub; // Whole char
+      u->txline = u->txinv;     // Space
+      u->txdrain = 1;
+   } else if (u->txdrain)
+   {                            // All sent
+      u->txdrain = 0;
+      if (atomic_load_explicit (&u->txwaiters, memory_order_acquire))
+         xSemaphoreGiveFromISR (u->txsem, &woken);      // Flush waiting
+      if (u->notify)
+         vTaskNotifyGiveFromISR (u->notify, &woken);
+   }
+   return woken == pdTRUE;
+}
+
+static void IRAM_ATTR
+tx_format (softuart_t * u)
+{                               // Apply a format change from softuart_format, from int, with tx and rx between characters
+   uint16_t fmt = atomic_exchange (&u->fmt, 0);
+   uint8_t bits = (fmt >> 8),
+      stopx10 = fmt;
+   if (bits)
+   {
+      u->bits = bits;
+      u->txfdata = (((1 << u->bits) - 1) << 1);
+      u->txfxor = ((1 << (u->bits + 1)) ^ (u->txinv ? (1 << (u->bits + 2)) - 1 : 0));
+   }
+   if (stopx10)
+   {
+      u->stopx10 = stopx10;
+      u->stops = (u->stopx10 * u->steps * 256 + 5) / 10;
+   }
+   u->charsub = (1 + u->bits) * u->steps + (u->stops >> 8);
+}
+
+static inline __attribute__((always_inline)) uint8_t
+port_tick (softuart_t * u, const uint8_t steps, const uint8_t byedge)
+{                               // Inlined in to each specialised handler below, so steps, and whether rx is by edge, are constants
+   BaseType_t woken = pdFALSE;
+   // Timing based, sample Rx (unless by edge) and set Tx (line level, inversion already applied)
+   uint8_t r = (byedge ? 1 : (gpio_get (u->rx) ^ u->rxinv));
+   if (u->txline)
       gpio_set (u->tx);
    else
       gpio_clr (u->tx);
@@ -92,68 +415,38 @@ timer_isr (void *up)
       u->txsubbit--;            // Working through sub bits
    if (u->crwait)
       u->crwait--;
+   if (u->allwait)
+      u->allwait--;
    if (!u->txsubbit)
    {                            // Work out next tx bit
+      if (!u->txbit && u->txline != u->txinv && atomic_load_explicit (&u->fmt, memory_order_relaxed)
+          && !(byedge ? u->rxbit : u->rxsubbit))
+         tx_format (u);         // Between characters (not in a break), so none garbled, before the next is loaded
       if (u->txbit)
-      {                         // Sending a byte
-         u->txbit--;
-         if (!u->txbit)
+      {                         // Sending a byte, next level from its frame
+         u->txline = (u->txframe & 1);
+         u->txframe >>= 1;
+         if (--u->txbit)
+            u->txsubbit = steps;        // Send next bit
+         else
          {                      // Stop bits at end of byte
-            u->txsubbit = u->stops;
-            u->txnext = 1;
-         } else
-         {
-            u->txsubbit = STEPS;        // Send next bit
-            u->txnext = (u->txbyte & 1);
-            u->txbyte >>= 1;
-         }
-      } else if (!u->txbit && !u->txwait)
-      {                         // Do we have a next byte to start
-         uint16_t txi = u->txi;
-         uint16_t txo = u->txo;
-         if (!u->txnext)
-         {
-            if (u->txbreak)
-               u->txbreak--;    // More break
-            else
-               u->txnext = 1;   // Idle
-            u->txsubbit = (1 + u->bits) * STEPS + u->stops;     // Whole char
-         } else if (txi != txo)
-         {                      // We have a byte
-            u->txbyte = u->txdata[txo];
-            uint8_t b = (u->txbyte & 0x7F);
-            if (!u->crwait || b < ' ' || b >= 0x7F)
-            {                   // Either Ok to send not (CR time done) or non printable, so OK to send anyway
-               txo++;
-               if (txo == sizeof (u->txdata))
-                  txo = 0;
-               u->txo = txo;
-               u->txbit = u->bits + 1;
-               u->txsubbit = STEPS;     // Start bit
-               u->txnext = 0;
-               if (b == '\r')
-               {                // CR
-                  if (!u->crwait)
-                     u->crwait = (int) u->pos * u->crline / u->linelen + (1 + u->bits) * STEPS + u->stops;      // Allow extra time for CR
-                  u->pos = 0;
-               } else if (b >= ' ' && b < 0x7F && u->pos < u->linelen)
-                  u->pos++;
-               u->stats.tx++;
-            }
-         } else if (u->txbreak)
-         {
-            u->txbreak--;
-            u->txsubbit = (1 + u->bits) * STEPS + u->stops;     // Whole char
-            u->txnext = 0;
+            uint16_t stops = u->stopacc + u->stops;
+            u->stopacc = stops;
+            u->txsubbit = (stops >> 8);
          }
-      }
+      } else if (!u->txwait && !u->allwait && tx_next (u))
+         woken = pdTRUE;
    }
+   const uint8_t txquiet = !(u->txsubbit || u->txbit || u->txline == u->txinv || u->txbreak || u->crwait || u->allwait
+                             || atomic_load_explicit (&u->fmt, memory_order_relaxed));
    // Rx
+   if (byedge)                  // Rx done by edge interrupt
+      return (woken == pdTRUE ? TICK_WOKEN : 0) | (txquiet ? TICK_QUIET : 0);
    if (!u->rxsubbit)
    {                            // Idle, waiting for start bit
       if (!r && !u->rxlast)
       {                         // Start bit (two 0's in a row to avoid glitches)
-         u->rxsubbit = STEPS - 1;       // We ate one bit already
+         u->rxsubbit = steps - 1;       // We ate one bit already
          u->rxbit = u->bits + 1;        // Data and start
          u->rxbyte = 0;
       }
@@ -163,7 +456,7 @@ timer_isr (void *up)
       u->rxsubbit--;
       if (!u->rxsubbit)
       {                         // Bit received
-         uint8_t b = ((u->rxcount > STEPS / 2) ? 1 : 0);        // c locked bit value
+         uint8_t b = ((u->rxcount * 2 > steps - 1) ? 1 : 0);      // clocked bit value, majority of steps-1 samples
          if (u->rxbit)
          {                      // Clocking in a byte
             if (u->rxbit == u->bits + 1 && b)
@@ -176,16 +469,16 @@ timer_isr (void *up)
                if (b)
                {
                   u->rxbyte |= (1 << (u->bits - 1));
-                  if (u->rxcount < STEPS - 1)
-                     u->stats.rxbad1++; // Should be all bits 1, allow 1
-                  else if (u->rxcount < STEPS)
-                     u->stats.rxbadish1++;      // Should be all bits 1
-               } else if (u->rxcount > 1)
-                  u->stats.rxbad0++;    // Should be none bits 1, allow 1
+                  if (u->rxcount < steps - 1 - (steps - 1) / 4)
+                     u->stats.rxbad1++; // Should be all samples 1, allow a quarter
+                  else if (u->rxcount < steps - 1)
+                     u->stats.rxbadish1++;      // Should be all samples 1
+               } else if (u->rxcount > (steps - 1) / 4)
+                  u->stats.rxbad0++;    // Should be no samples 1, allow a quarter
                else if (u->rxcount)
-                  u->stats.rxbadish0++; // Should be none bits 1
+                  u->stats.rxbadish0++; // Should be no samples 1
                u->rxbit--;
-               u->rxsubbit = STEPS;     // Next bit
+               u->rxsubbit = steps;     // Next bit
             }
          } else
          {                      // Stop bit
@@ -194,31 +487,29 @@ timer_isr (void *up)
                if (!b)
                {                // Bad stop bit, don't clock in byte
                   u->rxbreak = 1;       // Start of break condition
-                  u->rxsubbit = STEPS;  // Keep clocking stop bits
+                  u->rxsubbit = steps;  // Keep clocking stop bits
                   u->stats.rxbadstop++;
                } else
-               {                // Normal end of byte - record received byte (clean start and stop bit)
-                  uint16_t rxi = u->rxi;
-                  if (u->rxbyte != pe (u->rxbyte))
-                     u->stats.rxbadp++;
-                  u->rxdata[rxi] = u->rxbyte;
-                  rxi++;
-                  if (rxi == sizeof (u->rxdata))
-                     rxi = 0;
-                  if (rxi != u->rxo)
-                     u->rxi = rxi;      // Has space
-                  u->stats.rx++;
+               {                // Normal end of byte - record received byte
+                  if (rx_latch (u, u->rxbyte, esp_timer_get_time ()))
+                     xSemaphoreGiveFromISR (u->rxsem, &woken);
                   // leave rxsubbit unset so we wait for next start bit
                }
+               if (u->notify)
+                  vTaskNotifyGiveFromISR (u->notify, &woken);
             } else
             {                   // Check still in break condition.
                if (!b)
                {                // Still in break
                   if (u->rxbreak < 255)
                      u->rxbreak++;
-                  u->rxsubbit = STEPS;  // Keep clocking stop bits
+                  u->rxsubbit = steps;  // Keep clocking stop bits
                } else
+               {
                   u->rxbreak = 0;       // End of break - leave rxsubbit unset so we wait for next start bit
+                  if (u->notify)
+                     vTaskNotifyGiveFromISR (u->notify, &woken);
+               }
             }
          }
          u->rxcount = 0;
@@ -226,47 +517,651 @@ timer_isr (void *up)
          u->rxcount++;          // Count 1s
    }
    u->rxlast = r;
-   return false;
+   return (woken == pdTRUE ? TICK_WOKEN : 0) | (txquiet && !u->rxsubbit && r ? TICK_QUIET : 0);
+}
+
+static uint8_t IRAM_ATTR
+port_tick5 (softuart_t * u)
+{
+   return port_tick (u, 5, 0);
+}
+
+static uint8_t IRAM_ATTR
+port_tick8 (softuart_t * u)
+{
+   return port_tick (u, 8, 0);
+}
+
+static uint8_t IRAM_ATTR
+port_tick16 (softuart_t * u)
+{
+   return port_tick (u, 16, 0);
+}
+
+static uint8_t IRAM_ATTR
+port_tick5e (softuart_t * u)
+{
+   return port_tick (u, 5, 1);
+}
+
+static uint8_t IRAM_ATTR
+port_tick8e (softuart_t * u)
+{
+   return port_tick (u, 8, 1);
+}
+
+static uint8_t IRAM_ATTR
+port_tick16e (softuart_t * u)
+{
+   return port_tick (u, 16, 1);
+}
+
+static bool IRAM_ATTR
+timer_isr (void *tp)
+{                               // Timer interrupt, ticks each port due, the fastest port on the timer every time
+   softuart_timer_t *t = tp;
+   uint8_t flags = 0,
+      quiet = 1;
+   if (t->tickfrac || t->rearm)
+   {                            // Next tick period, alarm only changed when needed, i.e. after a restart or when the extra count changes
+      uint16_t acc = t->tickacc + t->tickfrac;
+      uint8_t extra = (acc < t->tickacc);
+      t->tickacc = acc;
+      if (t->rearm || extra != t->tickextra)
+      {
+         t->rearm = 0;
+         t->tickextra = extra;
+         timer_group_set_alarm_value_in_isr (0, t->timer, t->ticks + extra);
+      }
+   }
+   for (softuart_t * u = t->ports; u; u = u->next)
+   {
+      if (u->step < 65536)
+      {                         // Slower port, ticks on a phase accumulator, so within one timer tick of when it should
+         u->phase += u->step;
+         if (u->phase < 65536)
+         {
+            if (!u->quiet)
+               quiet = 0;
+            continue;
+         }
+         u->phase -= 65536;
+      }
+      uint8_t f = u->tick (u);
+      flags |= f;
+      if (!(u->quiet = (f & TICK_QUIET)))
+         quiet = 0;
+   }
+   if (quiet)
+      tick_idle (t);
+   return (flags & TICK_WOKEN);
+}
+
+static void IRAM_ATTR
+wake_isr (void *up)
+{                               // Rx start edge, restart timer if paused
+   tick_wake (up);
+}
+
+static void IRAM_ATTR
+edge_isr (void *up)
+{                               // Rx edge, just log the time and level for the decoder task
+   softuart_t *u = up;
+   uint32_t t = esp_timer_get_time ();
+   uint8_t r = (gpio_get (u->rx) ^ u->rxinv);
+   uint8_t edgei = u->edgei;
+   uint8_t next = ((edgei + 1) & (EDGES - 1));
+   if (next == u->edgeo)
+      u->stats.rxedgelost++;    // No space, edge lost
+   else
+   {
+      u->edge[edgei] = ((t & ~1) | r);
+      u->edgei = next;
+   }
+   BaseType_t woken = pdFALSE;
+   vTaskNotifyGiveFromISR (u->rxtask, &woken);
+   if (woken == pdTRUE)
+      portYIELD_FROM_ISR ();
+}
+
+static void
+timer_rate (softuart_timer_t * t)
+{                               // Set the timer to tick at the rate of the fastest port on it, and the other ports' steps to match (not from int)
+   portENTER_CRITICAL (&t->lock);
+   softuart_t *f = NULL;
+   for (softuart_t * u = t->ports; u; u = u->next)
+      if (!f || u->ticks < f->ticks || (u->ticks == f->ticks && u->tickfrac < f->tickfrac))
+         f = u;
+   if (f)
+   {
+      t->ticks = f->ticks;
+      t->tickfrac = f->tickfrac;
+      t->rearm = 1;             // Alarm is only set when it changes, so make sure it is
+      uint64_t q16 = ((uint64_t) f->ticks << 16) + f->tickfrac;
+      for (softuart_t * u = t->ports; u; u = u->next)
+         u->step = (q16 << 16) / (((uint64_t) u->ticks << 16) + u->tickfrac);
+   }
+   portEXIT_CRITICAL (&t->lock);
+}
+
+static uint32_t
+ms_sub (softuart_t * u, uint16_t ms)
+{                               // Tx wait in sub bits for ms at the baud rate
+   return (uint32_t) ms *u->steps * u->baudx100 / 100000;
+}
+
+static void
+tx_baud (softuart_t * u, uint16_t baudx100)
+{                               // Set tx timing for baud rate, can be while running (not from int)
+   uint64_t q16 = ((uint64_t) TIMER_BASE_CLK * 100 << 16) / u->steps / DIVIDER / baudx100;       // Counts per tick, Q16
+   portENTER_CRITICAL (&u->lock);
+   u->ticks = (q16 >> 16);
+   u->tickfrac = q16;
+   u->baudx100 = baudx100;
+   uint32_t w = ms_sub (u, u->crms);    // Tx waits are in ticks, so from the ms set, not scaled, so they do not drift
+   u->crline = (w > 65535 ? 65535 : w);
+   for (int c = 0; c < 32; c++)
+   {
+      w = ms_sub (u, u->holdms[c]);
+      u->hold[c] = (w > 60000 ? 60000 : w);
+   }
+   portEXIT_CRITICAL (&u->lock);
+   timer_rate (u->t);
+}
+
+static void
+rx_baud (softuart_t * u, uint16_t baudx100)
+{                               // Set rx edge decoder timing for baud rate, only from the rx edge task, or when it is not running
+   u->rxbitus = u->rxbitnom = 100000000 / baudx100;
+   u->rxgood = 0;
+   u->mn = u->mrisen = u->mfalln = u->mstopn = 0;        // Meter starts again
+}
+
+static void
+set_baud (softuart_t * u, uint16_t baudx100)
+{                               // Set timing for baud rate, can be while running (not from int or the rx edge task)
+   tx_baud (u, baudx100);
+   if (!u->rxtask)
+      rx_baud (u, baudx100);
+   else
+   {                            // The rx edge task is using the rx timing, so it applies it
+      atomic_store (&u->rxbaud, baudx100);
+      xTaskNotifyGive (u->rxtask);
+   }
+}
+
+static void
+rx_hunt (softuart_t * u, uint32_t gap, uint8_t level)
+{                               // Auto-baud, the rate and bias that best put the pulses from a few characters on whole bits
+   const uint32_t fast = 100000000 / autobauds[AUTOBAUDS - 1];
+   const uint32_t slow = 100000000 / autobauds[0];
+   if (gap < fast / 2 || gap > slow * 12)
+      return;                   // Glitch, or idle between characters
+   u->rxpulse[u->rxgaps++] = ((gap & ~1) | level);
+   if (u->rxgaps < PULSES)
+      return;                   // A few characters
+   u->rxgaps = 0;
+   uint16_t baudx100 = 0;
+   uint32_t best = 0;
+   for (int i = 0; i < AUTOBAUDS; i++)
+   {
+      const int32_t bit = 100000000 / autobauds[i];
+      for (int b = -8; b <= 8; b++)
+      {                         // Bias, marks long and spaces short by this, up to 40% of a bit
+         const int32_t bias = b * bit / 20;
+         uint32_t err = 0;      // Total distance from whole bits (1/1000 bit)
+         for (int p = 0; p < PULSES; p++)
+         {
+            uint8_t mark = (u->rxpulse[p] & 1);
+            int32_t m = (u->rxpulse[p] & ~1) - (mark ? bias : -bias);
+            int32_t k = (m + bit / 2) / bit;
+            if (mark && k > u->bits + 2)
+               continue;        // Idle
+            if (m <= 0 || !k || k > u->bits + 2)
+               err += 500;
+            else
+               err += (m > k * bit ? m - k * bit : k * bit - m) * 1000 / bit;
+         }
+         if (!baudx100 || err < best)
+         {
+            baudx100 = autobauds[i];
+            best = err;
+         }
+      }
+   }
+   if (best > PULSES * 100)
+      return;                   // Average more than a tenth of a bit off, try again
+   tx_baud (u, baudx100);       // From the rx edge task, so rx timing set here
+   rx_baud (u, baudx100);
+   u->rxhunt = 0;
+   u->rxsync = 1;               // Likely mid character
+}
+
+static void
+rx_fit (softuart_t * u)
+{                               // Fit this character's bit time to its edges so far, least squares, each edge on its nearest bit boundary
+   // The tracked bit time counts as one more edge, at bit 1 rising to bit 4 as it settles, so one distorted edge cannot pull the fit far
+   // Edges are placed again on each pass, so one misplaced by the starting point is picked up again. Within 12.5% of nominal
+   const uint32_t w = 1 + (u->rxgood < 15 ? u->rxgood : 15);
+   const int32_t rise = (u->mrisen ? u->mrise : 0);
+   const int32_t fall = (u->mfalln ? u->mfall : 0);
+   uint32_t b = u->rxbitus;
+   for (int pass = 0; pass < 3; pass++)
+   {
+      uint32_t sdk = w * u->rxbitus;
+      uint32_t skk = w;
+      u->rxmiss = 0;
+      for (int i = 0; i < u->rxn; i++)
+      {
+         int32_t bias = ((u->rxe[i] & 1) ? rise : fall);
+         uint32_t d = (u->rxe[i] & ~1) - (int64_t) bias * (int32_t) b / 65536;     // Allow for metered distortion, so bias is not speed
+         uint32_t k = (d + b / 2) / b;  // Bit boundary it should be on
+         uint32_t e = (d > k * b ? d - k * b : k * b - d);
+         if (!k || k > u->bits + 1 || e * 4 > b)
+         {                      // Too far off, glitch, and if a long way off likely not in sync with the sender
+            if (!k || k > u->bits + 1 || e * 5 > b * 2)
+               u->rxmiss++;
+            continue;
+         }
+         sdk += d * k;
+         skk += k * k;
+      }
+      b = sdk / skk;
+      if (b * 8 < u->rxbitnom * 7)
+         b = u->rxbitnom * 7 / 8;
+      else if (b * 8 > u->rxbitnom * 9)
+         b = u->rxbitnom * 9 / 8;
+   }
+   u->rxcbit = b;
+}
+
+static void
+meter (int32_t * v, uint32_t n, int32_t x)
+{                               // Running average, n is how many values so far, the first value sets it
+   if (!n)
+      *v = x;
+   else
+      *v += (x - *v) / 16;
+}
+
+static void
+rx_meter (softuart_t * u, uint32_t bit)
+{                               // Meter a good character, edge offsets are from where they should be given its fitted bit time
+   int32_t peak = 0;
+   for (int i = 0; i < u->rxn; i++)
+   {
+      uint32_t d = (u->rxe[i] & ~1);
+      uint32_t k = (d + bit / 2) / bit;
+      if (!k || k > u->bits + 1)
+         continue;
+      int32_t off = ((int64_t) d - (int64_t) k * bit) * 65536 / (int32_t) bit;
+      if (u->rxe[i] & 1)
+         meter (&u->mrise, u->mrisen++, off);
+      else
+         meter (&u->mfall, u->mfalln++, off);
+      if (off < 0)
+         off = -off;
+      if (off > peak)
+         peak = off;
+   }
+   meter (&u->mspeed, u->mn, ((int64_t) u->rxbitnom - (int64_t) bit) * 65536 / (int32_t) bit);
+   meter (&u->mpeak, u->mn, peak);
+   u->mn++;
+   u->mstopt = u->rxt0 + (u->bits + 1) * bit;
+   u->mstopbit = bit;
+   u->mstopok = 1;
+}
+
+static void
+rx_char (softuart_t * u)
+{                               // Character time done (3/4 of stop bit), decide bits from high time in each, using this character's bit time
+   const uint32_t bit = u->rxcbit;
+   const uint32_t end = (u->bits + 1) * bit + bit * 3 / 4;      // Late in stop bit, allows for a late rising edge, still before a next start bit
+   uint32_t cell[10] = { 0 };   // High time (us) in each of start, data, and first 3/4 of stop bit
+   u->rxbit = 0;
+   u->mstopok = 0;
+   for (int i = 1; i <= u->rxn; i++)
+   {                            // Low from start bit edge to first logged edge, then level after each edge up to the next
+      if (!(u->rxe[i - 1] & 1))
+         continue;
+      uint32_t a = (u->rxe[i - 1] & ~1);
+      uint32_t b = (i < u->rxn ? (u->rxe[i] & ~1) : end);
+      if (b > end)
+         b = end;
+      while (a < b)
+      {
+         uint32_t c = a / bit;
+         uint32_t e = (c + 1) * bit;
+         if (e > b)
+            e = b;
+         cell[c] += e - a;
+         a = e;
+      }
+   }
+   if (cell[0] * 2 > bit)
+   {                            // Bad start bit
+      u->stats.rxbadstart++;
+      return;
+   }
+   uint8_t byte = 0;
+   for (int i = u->bits; i; i--)
+   {
+      uint32_t h = cell[i];
+      byte <<= 1;
+      uint32_t wrong = h;
+      if (h * 2 > bit)
+      {
+         byte |= 1;
+         wrong = bit - h;
+         if (wrong * 4 > bit)
+            u->stats.rxbad1++;  // Should be all high, allow a quarter
+         else if (wrong * 16 > bit)
+            u->stats.rxbadish1++;       // Should be all high, allow a little edge jitter
+      } else if (wrong * 4 > bit)
+         u->stats.rxbad0++;     // Should be all low, allow a quarter
+      else if (wrong * 16 > bit)
+         u->stats.rxbadish0++;  // Should be all low, allow a little edge jitter
+   }
+   if (cell[u->bits + 1] * 8 <= bit * 3)
+   {                            // Bad stop bit (not high for half of what we looked at), don't clock in byte
+      u->rxbreak = 1;           // Start of break condition
+      u->rxt0 += (u->bits + 1) * bit;   // Break timing from stop bit
+      u->stats.rxbadstop++;
+      if (u->notify)
+         xTaskNotifyGive (u->notify);
+      return;
+   }
+   if (!u->rxmiss)
+   {                            // All edges where expected, so likely in sync with the sender, use for tracking and metering
+      u->rxbitus += ((int32_t) bit - (int32_t) u->rxbitus) / 4; // Track slowly, starting point for next character
+      if (u->rxgood < 16)
+         u->rxgood++;           // Not settled yet, so not metered
+      else
+         rx_meter (u, bit);
+   }
+   if (rx_latch (u, byte, u->rxt0 + end))
+      xSemaphoreGive (u->rxsem);
+   if (u->notify)
+      xTaskNotifyGive (u->notify);
+}
+
+static uint32_t
+softuart_rx_edges (softuart_t * u, uint32_t now)
+{                               // Process logged rx edges up to now (us), returns us until this needs calling again, 0 for next edge
+   while (1)
+   {
+      const uint32_t bit = u->rxbitus;
+      uint8_t edgeo = u->edgeo;
+      uint8_t have = (edgeo != u->edgei);
+      uint32_t e = (have ? u->edge[edgeo] : 0);
+      uint32_t t = (have ? (e & ~1) : now);
+      if (u->rxbit)
+      {                         // Receiving a character
+         const uint32_t cbit = u->rxcbit;
+         uint32_t end = u->rxt0 + (u->bits + 1) * cbit + cbit * 3 / 4;
+         if ((int32_t) (t - end) >= 0)
+         {                      // Character done, edge (if any) is after it so left for next time around
+            rx_char (u);
+            continue;
+         }
+         if (!have)
+            return end - now;
+         u->rxlevel = (e & 1);
+         u->rxlastt = t;
+         u->edgeo = ((edgeo + 1) & (EDGES - 1));
+         if ((u->rxlevel && t - u->rxt0 < cbit / 2) || u->rxn == RXE)
+         {                      // Glitch, back high in first half of start bit, or too noisy
+            u->rxbit = 0;
+            u->stats.rxbadstart++;
+            continue;
+         }
+         u->rxe[u->rxn++] = (((t - u->rxt0) & ~1) | u->rxlevel);
+         rx_fit (u);
+         continue;
+      }
+      if (!have)
+      {
+         if (!u->rxbreak || u->rxhunt || u->rxsync)
+            return 0;           // Idle, wait for an edge
+         uint32_t n = (now - u->rxt0) / bit + 1;        // Still in break
+         u->rxbreak = (n > 255 ? 255 : n);
+         return bit;
+      }
+      u->edgeo = ((edgeo + 1) & (EDGES - 1));
+      uint32_t gap = t - u->rxlastt;
+      uint8_t was = u->rxlevel;
+      u->rxlevel = (e & 1);
+      u->rxlastt = t;
+      if (u->rxhunt)
+      {
+         rx_hunt (u, gap, was);
+         continue;
+      }
+      if (u->rxsync)
+      {                         // Start bit only after a character time idle
+         if (!was || gap < (u->bits + 2) * bit)
+            continue;
+         u->rxsync = 0;
+      }
+      if (u->rxlevel)
+      {
+         if (u->rxbreak && u->rxauto && t - u->rxt0 > 2 * (u->bits + 2) * bit)
+         {                      // Long break, hunt again
+            u->rxhunt = 1;
+            u->rxgaps = 0;
+         }
+         if (u->rxbreak && u->notify)
+            xTaskNotifyGive (u->notify);
+         u->rxbreak = 0;        // End of break
+      } else if (!u->rxbreak)
+      {                         // Start bit
+         if (u->mstopok && t - u->mstopt < 4 * u->mstopbit)
+            meter (&u->mstop, u->mstopn++, (int64_t) (t - u->mstopt) * 65536 / u->mstopbit);    // Sending continuously
+         u->mstopok = 0;
+         u->rxt0 = t;
+         u->rxbit = u->bits + 1;
+         u->rxcbit = u->rxbitus;
+         u->rxn = 0;
+         u->rxmiss = 0;
+      }
+   }
+}
+
+static void
+rx_task (void *up)
+{                               // Rx edge decoder - timing is from the edge times logged by the interrupt, so latency here does not matter
+   softuart_t *u = up;
+   uint32_t wait = 0;
+   while (1)
+   {
+      ulTaskNotifyTake (pdTRUE, wait ? pdMS_TO_TICKS (wait / 1000) + 1 : portMAX_DELAY);
+      uint16_t baudx100 = atomic_exchange (&u->rxbaud, 0);
+      if (baudx100)
+         rx_baud (u, baudx100); // Set by set_baud
+      wait = softuart_rx_edges (u, esp_timer_get_time ());
+   }
 }
 
    // Set up
 softuart_t *
-softuart_init (int8_t timer, revk_gpio_t tx, revk_gpio_t rx, uint16_t baudx100, uint8_t bits, uint8_t stopx2, uint8_t linelen,
-               uint16_t crms)
+softuart_init (int8_t timer, revk_gpio_t tx, revk_gpio_t rx, uint16_t baudx100, uint8_t bits, uint8_t stopx10, uint8_t steps,
+               uint8_t linelen, uint16_t crms, uint32_t txsize, uint16_t rxsize, char psram, char edge)
 {
-   if (timer < 0 || !tx.set || !rx.set || tx.num == rx.num ||   //
+   if (timer < 0 || timer >= TIMERS || !tx.set || !rx.set || tx.num == rx.num ||        //
        !GPIO_IS_VALID_OUTPUT_GPIO (tx.num)      //
        || !GPIO_IS_VALID_GPIO (rx.num)  //
       )
       return NULL;
-#ifdef	CONFIG_IDF_TARGET_ESP32S3
+   if (txsize < 2)
+      txsize = 32768;
+   if (rxsize < 2)
+      rxsize = 32;
+   // Everything the interrupt touches is internal RAM, except the tx data which can be in PSRAM
    softuart_t *u = heap_caps_malloc (sizeof (*u), MALLOC_CAP_INTERNAL);
-#else
-   softuart_t *u = malloc (sizeof (*u));
-#endif
    if (!u)
       return u;
    memset (u, 0, sizeof (*u));
-   u->mutex = xSemaphoreCreateMutex ();
-   u->baudx100 = (baudx100 ? : 11000);
+   softuart_timer_t *t = &timers[timer];
+   if (!t->ports)
+   {                            // First port on this timer
+      portMUX_INITIALIZE (&t->lock);
+      t->timer = timer;
+   }
+   u->t = t;
+#ifdef	CONFIG_SPIRAM
+   if (psram && !t->ports && (u->txdata = heap_caps_malloc (txsize, MALLOC_CAP_SPIRAM)))
+      u->psram = 1;             // Only the first port on a timer, as the int handler is only not in IRAM if started with it
+#endif
+   if (!u->txdata)
+      u->txdata = heap_caps_malloc (txsize, MALLOC_CAP_INTERNAL);
+   u->rxdata = heap_caps_malloc (rxsize, MALLOC_CAP_INTERNAL);
+   u->rxts = heap_caps_malloc (rxsize * sizeof (*u->rxts), MALLOC_CAP_INTERNAL);
+   if (!u->txdata || !u->rxdata || !u->rxts)
+   {
+      heap_caps_free (u->txdata);
+      heap_caps_free (u->rxdata);
+      heap_caps_free (u->rxts);
+      heap_caps_free (u);
+      return NULL;
+   }
+   u->txsize = txsize;
+   u->rxsize = rxsize;
+   portMUX_INITIALIZE (&u->lock);
+   u->txsem = xSemaphoreCreateBinary ();
+   u->rxsem = xSemaphoreCreateBinary ();
    u->bits = (bits ? : 8);
-   u->stops = ((stopx2 ? : 4) * STEPS + 1) / 2;
+   u->rxbyedge = (edge ? 1 : 0);
+   if (steps >= 16)
+   {
+      u->steps = 16;
+      u->tick = (u->rxbyedge ? port_tick16e : port_tick16);
+   } else if (steps >= 8)
+   {
+      u->steps = 8;
+      u->tick = (u->rxbyedge ? port_tick8e : port_tick8);
+   } else
+   {
+      u->steps = 5;
+      u->tick = (u->rxbyedge ? port_tick5e : port_tick5);
+   }
+   u->stopx10 = (stopx10 ? : 20);
+   u->stops = (u->stopx10 * u->steps * 256 + 5) / 10;
+   u->charsub = (1 + u->bits) * u->steps + (u->stops >> 8);
    u->tx = tx.num;
    u->txinv = tx.invert;
-   u->txnext = 1;
+   u->txline = !u->txinv;       // Idle
+   u->txfdata = (((1 << u->bits) - 1) << 1);
+   u->txfxor = ((1 << (u->bits + 1)) ^ (u->txinv ? (1 << (u->bits + 2)) - 1 : 0));
    u->rx = rx.num;
    u->rxinv = rx.invert;
    u->rxlast = 1;
-   u->timer = timer;
+   u->rxlevel = 1;
+   u->quiet = 1;
+   u->crms = crms;
+   set_baud (u, baudx100 ? : 11000);
    u->linelen = linelen;
    u->pos = linelen;
-   if (crms)
-      u->crline = (uint32_t) crms *STEPS * baudx100 / 100000;
    revk_gpio_output (tx, 1);
    revk_gpio_input (rx);
+   portENTER_CRITICAL (&t->lock);
+   u->next = t->ports;          // Ticked from now if the timer is running for other ports
+   t->ports = u;
+   portEXIT_CRITICAL (&t->lock);
+   timer_rate (t);
    return u;
 }
 
+void
+softuart_hold (softuart_t * u, uint8_t c, uint16_t ms, char all)
+{                               // Set the time a control character needs after it, before printable characters, or all characters if all set
+   if (!u || c >= 32 || c == '\r')
+      return;
+   u->holdms[c] = ms;           // Kept, for set_baud
+   uint32_t w = ms_sub (u, ms);
+   u->hold[c] = (w > 60000 ? 60000 : w);
+   if (all)
+      u->holdall |= (1 << c);
+   else
+      u->holdall &= ~(1 << c);
+}
+
+void
+softuart_baud (softuart_t * u, uint16_t baudx100)
+{                               // Change baud rate, e.g. once auto-baud has locked or by command
+   if (!u || !baudx100)
+      return;
+   set_baud (u, baudx100);
+}
+
+void
+softuart_format (softuart_t * u, uint8_t bits, uint8_t stopx10)
+{                               // Change data bits (5 to 8) and stop bits (x10), 0 to leave as is, e.g. by command, applied by the int between characters
+   if (!u)
+      return;
+   if (bits < 5 || bits > 8)
+      bits = 0;
+   if (!bits && !stopx10)
+      return;
+   portENTER_CRITICAL (&u->lock);
+   uint16_t fmt = atomic_load (&u->fmt);        // Merged with any not yet applied, if the int applies that meanwhile it is applied again
+   if (bits)
+      fmt = ((fmt & 0xFF) | (bits << 8));
+   if (stopx10)
+      fmt = ((fmt & 0xFF00) | stopx10);
+   atomic_store (&u->fmt, fmt);
+   portEXIT_CRITICAL (&u->lock);
+   tick_wake (u);
+}
+
+void
+softuart_get_format (softuart_t * u, uint16_t * baudx100, uint8_t * bits, uint8_t * stopx10)
+{                               // Current baud rate, data bits, and stop bits (x10), including a format change not yet applied
+   if (!u)
+      return;
+   uint16_t fmt = atomic_load (&u->fmt);
+   if (baudx100)
+      *baudx100 = u->baudx100;
+   if (bits)
+      *bits = ((fmt >> 8) ? : u->bits);
+   if (stopx10)
+      *stopx10 = ((fmt & 0xFF) ? : u->stopx10);
+}
+
+void
+softuart_notify (softuart_t * u, TaskHandle_t task)
+{                               // Set a task to notify (give) on rx byte, rx break start or end, and tx drained, e.g. to wake a select loop
+   if (!u)
+      return;
+   u->notify = task;
+}
+
+void
+softuart_autobaud (softuart_t * u, char on)
+{                               // Set auto-baud (rxedge only), if on hunts for the rx baud rate now, and after any long break
+   if (!u || !u->rxbyedge)
+      return;
+   u->rxgaps = 0;
+   u->rxauto = u->rxhunt = (on ? 1 : 0);
+}
+
+static void
+rx_isr (softuart_t * u, char add)
+{                               // Add or remove the rx GPIO interrupt handler
+   if (!add)
+   {
+      gpio_isr_handler_remove (u->rx);
+      gpio_set_intr_type (u->rx, GPIO_INTR_DISABLE);
+   } else if (u->rxbyedge)
+   {
+      gpio_set_intr_type (u->rx, GPIO_INTR_ANYEDGE);
+      gpio_isr_handler_add (u->rx, edge_isr, u);
+   } else
+   {                            // Start bit edge to restart timer when idle
+      gpio_set_intr_type (u->rx, u->rxinv ? GPIO_INTR_POSEDGE : GPIO_INTR_NEGEDGE);
+      gpio_isr_handler_add (u->rx, wake_isr, u);
+   }
+}
+
 void
 softuart_start (softuart_t * u)
 {
@@ -275,26 +1170,58 @@ softuart_start (softuart_t * u)
    if (u->started)
       return;
    u->started = 1;
-   uint32_t divider = 2;        // min 2
-   uint32_t ticks = (uint64_t) TIMER_BASE_CLK * 100 / STEPS / divider / u->baudx100;
-   //ESP_LOGE("UART", "Baudx100=%u Base=%u divider=%d ticks=%u", u->baudx100, TIMER_BASE_CLK, divider, ticks);
-
-   // Set up timer
-   timer_config_t config = {
-      .divider = divider,
-      .counter_dir = TIMER_COUNT_UP,
-      .counter_en = TIMER_PAUSE,
-      .alarm_en = TIMER_ALARM_EN,
-      .intr_type = TIMER_INTR_LEVEL,
-      .auto_reload = 1,
-      .clk_src = TIMER_SRC_CLK_DEFAULT,
-   };
-   timer_init (0, u->timer, &config);
-   timer_set_counter_value (0, u->timer, 0x00000000ULL);
-   timer_set_alarm_value (0, u->timer, ticks);
-   timer_isr_callback_add (0, u->timer, timer_isr, u, ESP_INTR_FLAG_LOWMED | ESP_INTR_FLAG_IRAM);
-   timer_enable_intr (0, u->timer);
-   timer_start (0, u->timer);
+   softuart_timer_t *t = u->t;
+   if (!t->started)
+   {                            // First port started on this timer
+      t->started = 1;
+      //ESP_LOGE("UART", "Baudx100=%u Base=%u divider=%d ticks=%u", u->baudx100, TIMER_BASE_CLK, DIVIDER, t->ticks);
+      char iram = 1;
+      for (softuart_t * p = t->ports; p; p = p->next)
+         if (p->psram)
+            iram = 0;
+      // Set up timer
+      timer_config_t config = {
+         .divider = DIVIDER,
+         .counter_dir = TIMER_COUNT_UP,
+         .counter_en = TIMER_PAUSE,
+         .alarm_en = TIMER_ALARM_EN,
+         .intr_type = TIMER_INTR_LEVEL,
+         .auto_reload = 1,
+         .clk_src = TIMER_SRC_CLK_DEFAULT,
+      };
+      timer_init (0, t->timer, &config);
+      timer_set_counter_value (0, t->timer, 0x00000000ULL);
+      timer_set_alarm_value (0, t->timer, t->ticks);    // Set by timer_rate
+      // PSRAM is not accessible while flash cache is disabled, so the interrupt cannot run from IRAM in that case
+      timer_isr_callback_add (0, t->timer, timer_isr, t, ESP_INTR_FLAG_LOWMED | (iram ? ESP_INTR_FLAG_IRAM : 0));
+      timer_enable_intr (0, t->timer);
+      timer_start (0, t->timer);
+   }
+   gpio_install_isr_service (ESP_INTR_FLAG_IRAM);       // May already be installed
+   if (u->rxbyedge)
+      xTaskCreate (rx_task, "softuart", 2 * 1024, u, 5, &u->rxtask);
+   rx_isr (u, 1);
+}
+
+void
+softuart_stop (softuart_t * u)
+{                               // Stop rx, i.e. its pin interrupt and edge decoder task, so rx pin and timing can be changed, softuart_start again after
+   if (!u || !u->started)
+      return;
+   u->started = 0;
+   rx_isr (u, 0);
+   if (u->rxtask)
+   {
+      vTaskDelete (u->rxtask);
+      u->rxtask = NULL;
+   }
+   uint16_t baudx100 = atomic_exchange (&u->rxbaud, 0);
+   if (baudx100)
+      rx_baud (u, baudx100);    // Not yet applied by the task
+   u->edgeo = u->edgei;         // Decoder starts again, waiting for the line idle
+   u->rxbit = 0;
+   u->rxlevel = 1;
+   u->rxsync = 1;
 }
 
 void *
@@ -302,72 +1229,254 @@ softuart_end (softuart_t * u)
 {
    if (!u)
       return NULL;
-   if (u->started)
-      timer_disable_intr (0, u->timer);
-   if (u->mutex)
-      vSemaphoreDelete (u->mutex);
+   softuart_timer_t *t = u->t;
+   portENTER_CRITICAL (&t->lock);
+   softuart_t **pp = &t->ports;
+   while (*pp != u)
+      pp = &(*pp)->next;
+   *pp = u->next;               // No longer ticked
+   portEXIT_CRITICAL (&t->lock);
+   softuart_stop (u);
+   if (t->started)
+      vTaskDelay (1);           // Let an int handler part way through the ports (on the other core) finish with this one
+   if (t->ports)
+      timer_rate (t);
+   else if (t->started)
+   {                            // Last port on this timer
+      timer_disable_intr (0, t->timer);
+      timer_isr_callback_remove (0, t->timer);
+      t->started = 0;
+   }
+   if (u->txsem)
+      vSemaphoreDelete (u->txsem);
+   if (u->rxsem)
+      vSemaphoreDelete (u->rxsem);
+   heap_caps_free (u->txdata);
+   heap_caps_free (u->rxdata);
+   heap_caps_free (u->rxts);
    heap_caps_free (u);
    return NULL;
 }
 
 // Low level messaging
+static int
+tx_queue (softuart_t * u, const uint8_t * buf, int len, char wait, uint16_t count)
+{                               // Queue bytes, lock free for several writers. Returns number queued, which is all of them if wait set
+   // If count is more than 1 then buf[0] is sent count times, with len 1, using one tx ring byte and a repeat descriptor
+   // Without wait this does not block, other than yielding to an earlier writer finishing its copy, repeats are always with wait
+   if (!u || len <= 0)
+      return 0;
+   int done = 0;
+   uint8_t waiting = 0;
+   while (1)
+   {
+      uint32_t txres = atomic_load_explicit (&u->txres, memory_order_relaxed);
+      uint32_t next;
+      int space;
+      do
+      {                         // Reserve space, txres .. next
+         space = (int) atomic_load_explicit (&u->txo, memory_order_acquire) - (int) txres - 1;
+         if (space < 0)
+            space += u->txsize;
+         if (space > len - done)
+            space = len - done;
+         next = txres + space;
+         if (next >= u->txsize)
+            next -= u->txsize;
+      }
+      while (space
+             && !atomic_compare_exchange_weak_explicit (&u->txres, &txres, next, memory_order_relaxed, memory_order_relaxed));
+      if (space)
+      {                         // Copy in, in up to two parts as it may wrap
+         int n = u->txsize - txres;
+         if (n > space)
+            n = space;
+         memcpy (u->txdata + txres, buf + done, n);
+         if (n < space)
+            memcpy (u->txdata, buf + done + n, space - n);
+         for (int spin = 0; atomic_load_explicit (&u->txi, memory_order_relaxed) != txres; spin++)
+         {                      // Another writer reserved before us and has not committed yet, it is at most a copy away
+            if (spin < 100)
+               taskYIELD ();
+            else
+               vTaskDelay (1);  // Lower priority writer, which cannot run while we only yield
+         }
+         if (count > 1)
+         {                      // Add repeat descriptor, only the committing writer does this, so one writer at a time
+            uint8_t repi = atomic_load_explicit (&u->repi, memory_order_relaxed);
+            uint8_t nexti = ((repi + 1) & (REPS - 1));
+            if (atomic_load_explicit (&u->repo, memory_order_acquire) == nexti)
+            {                   // Descriptors full, the int gives txsem as it finishes a repeat (moving txo on)
+               atomic_fetch_add (&u->txwaiters, 1);
+               while (atomic_load_explicit (&u->repo, memory_order_acquire) == nexti)
+                  xSemaphoreTake (u->txsem, portMAX_DELAY);
+               atomic_fetch_sub (&u->txwaiters, 1);
+            }
+            u->rep[repi].slot = txres;
+            u->rep[repi].count = count;
+            atomic_store_explicit (&u->repi, nexti, memory_order_release);
+         }
+         atomic_store_explicit (&u->txi, next, memory_order_release);   // Commit
+         tick_wake (u);
+         done += space;
+         uint32_t txo = atomic_load_explicit (&u->txo, memory_order_relaxed);
+         uint32_t queued = (next >= txo ? next - txo : next + u->txsize - txo);
+         if (queued > u->stats.txhigh)
+            u->stats.txhigh = queued;
+      }
+      if (done == len || !wait)
+         break;
+      if (!waiting)
+      {                         // Register as waiting, then check space again, so a byte taken after the check still signals us
+         waiting = 1;
+         atomic_fetch_add (&u->txwaiters, 1);
+         continue;
+      }
+      xSemaphoreTake (u->txsem, portMAX_DELAY);
+   }
+   if (waiting)
+      atomic_fetch_sub (&u->txwaiters, 1);
+   return done;
+}
+
+int
+softuart_tx_buf (softuart_t * u, const uint8_t * buf, int len, char wait)
+{                               // Queue bytes, returns number queued, which is all of them if wait set
+   return tx_queue (u, buf, len, wait, 1);
+}
+
 void
 softuart_tx (softuart_t * u, uint8_t b)
 {
+   softuart_tx_buf (u, &b, 1, 1);
+}
+
+void
+softuart_tx_rep (softuart_t * u, uint8_t b, uint32_t n)
+{                               // Send byte n times (e.g. tape leader), blocking, using one tx ring byte per 65535
+   while (n)
+   {
+      uint16_t count = (n > 65535 ? 65535 : n);
+      tx_queue (u, &b, 1, 1, count);
+      n -= count;
+   }
+}
+
+void
+softuart_tx_pri (softuart_t * u, uint8_t b)
+{                               // Send byte ahead of any waiting in the main tx ring, blocking
    if (!u)
       return;
-   uint16_t txp = u->txi,
-      txi = txp + 1;
-   if (txi == sizeof (u->txdata))
-      txi = 0;
+   uint8_t waiting = 0;
    while (1)
-   {
-      xSemaphoreTake (u->mutex, portMAX_DELAY); // Just to protect from itself, e.g. called from different tasks
-      if (u->txo != txi)
-      {                         // We have space
-         u->txdata[txp] = b;
-         u->txi = txi;
-         xSemaphoreGive (u->mutex);
-         return;
+   {                            // Several writers, so a short spinlock, not waiting behind main tx ring writers
+      uint8_t done = 0;
+      portENTER_CRITICAL (&u->lock);
+      uint8_t prii = u->prii;
+      uint8_t next = ((prii + 1) & (PRI - 1));
+      if (next != u->prio)
+      {
+         u->pri[prii] = b;
+         u->prii = next;
+         done = 1;
       }
-      xSemaphoreGive (u->mutex);
-      usleep (1000);            // Wait a bit - yes, some sort of mutex for this would be cleaner, but at this Baud rate?
+      portEXIT_CRITICAL (&u->lock);
+      if (done)
+         break;
+      if (!waiting)
+      {                         // Register as waiting, then check space again, as for the main tx ring
+         waiting = 1;
+         atomic_fetch_add (&u->txwaiters, 1);
+         continue;
+      }
+      xSemaphoreTake (u->txsem, portMAX_DELAY);
    }
+   if (waiting)
+      atomic_fetch_sub (&u->txwaiters, 1);
+   tick_wake (u);
+}
+
+void
+softuart_pri_block (softuart_t * u, uint8_t on, uint8_t off)
+{                               // Priority bytes do not go ahead of the main tx ring after on is sent, until off, e.g. DC2/DC4 tape punch
+   if (!u)
+      return;
+   u->prioff = off;
+   u->prion = on;
+}
+
+int
+softuart_rx_buf (softuart_t * u, uint8_t * buf, int len)
+{                               // Receive what bytes are available, up to len, non blocking, one reader only. Returns number received
+   if (!u || len <= 0)
+      return 0;
+   uint16_t rxo = atomic_load_explicit (&u->rxo, memory_order_relaxed);
+   int n = (int) atomic_load_explicit (&u->rxi, memory_order_acquire) - (int) rxo;
+   if (n < 0)
+      n += u->rxsize;
+   if (n > len)
+      n = len;
+   for (int i = 0; i < n; i++)
+   {
+      buf[i] = u->rxdata[rxo++];
+      if (rxo == u->rxsize)
+         rxo = 0;
+   }
+   atomic_store_explicit (&u->rxo, rxo, memory_order_release);
+   return n;
 }
 
 uint8_t
 softuart_rx (softuart_t * u)
-{
+{                               // Receive a byte, blocking, one reader only
+   return softuart_rx_ts (u, NULL);
+}
+
+uint8_t
+softuart_rx_ts (softuart_t * u, int64_t * ts)
+{                               // Receive a byte, blocking, one reader only, and set time of its stop bit (us) if ts not NULL
    if (!u)
       return 0;
-   uint16_t rxo = u->rxo;
+   uint16_t rxo = atomic_load_explicit (&u->rxo, memory_order_relaxed);
    while (1)
    {
-      xSemaphoreTake (u->mutex, portMAX_DELAY); // Just to protect from itself, e.g. called from different tasks
-      if (u->rxi != rxo)
-      {                         // There are bytes
-         uint8_t b = u->rxdata[rxo];
-         rxo++;
-         if (rxo == sizeof (u->rxdata))
-            rxo = 0;
-         u->rxo = rxo;
-         xSemaphoreGive (u->mutex);
-         return b;
-      }
-      xSemaphoreGive (u->mutex);
-      usleep (1000);            // Wait a bit - yes, some sort of mutex for this would be cleaner, but at this Baud rate?
+      atomic_store_explicit (&u->rxblock, 1, memory_order_seq_cst);     // Set before checking, so a byte stored after the check still signals us
+      if (atomic_load_explicit (&u->rxi, memory_order_seq_cst) != rxo)
+         break;                 // There are bytes
+      xSemaphoreTake (u->rxsem, portMAX_DELAY);
    }
+   atomic_store_explicit (&u->rxblock, 0, memory_order_relaxed);
+   uint8_t b = u->rxdata[rxo];
+   if (ts)
+   {                            // Widen, byte will have arrived less than 71 minutes ago
+      int64_t now = esp_timer_get_time ();
+      *ts = now - (uint32_t) ((uint32_t) now - u->rxts[rxo]);
+   }
+   rxo++;
+   if (rxo == u->rxsize)
+      rxo = 0;
+   atomic_store_explicit (&u->rxo, rxo, memory_order_release);
+   return b;
+}
+
+int
+softuart_tx_size (softuart_t * u)
+{                               // Tx ring size, the most that can be queued
+   if (!u)
+      return 0;
+   return u->txsize - 1;
 }
 
 int
 softuart_tx_space (softuart_t * u)
-{                               // Report how much space for sending
+{                               // Report how much space for sending, i.e. not reserved by any writer
    if (!u)
       return 0;
-   int s = (int) u->txi - (int) u->txo;
+   uint32_t txo = atomic_load_explicit (&u->txo, memory_order_acquire);
+   int s = (int) atomic_load_explicit (&u->txres, memory_order_acquire) - (int) txo;
    if (s < 0)
-      s += sizeof (u->txdata);
-   return sizeof (u->txdata) - 1 - s;   // -1 as never completely fills
+      s += u->txsize;
+   return u->txsize - 1 - s;    // -1 as never completely fills
 }
 
 int
@@ -375,21 +1484,53 @@ softuart_tx_waiting (softuart_t * u)
 {                               // Report how many bytes still being transmitted including one in process of transmission
    if (!u)
       return 0;
-   int s = (int) u->txi - (int) u->txo;
+   uint32_t txo = atomic_load_explicit (&u->txo, memory_order_acquire);
+   int s = (int) atomic_load_explicit (&u->txi, memory_order_acquire) - (int) txo;
    if (s < 0)
-      s += sizeof (u->txdata);
+      s += u->txsize;
+   s += ((u->prii - u->prio) & (PRI - 1));
+   uint8_t repo = atomic_load_explicit (&u->repo, memory_order_acquire);
+   for (uint8_t r = repo; r != atomic_load_explicit (&u->repi, memory_order_acquire); r = ((r + 1) & (REPS - 1)))
+      s += u->rep[r].count - 1; // Repeats not yet sent, less the one counted in the ring
+   uint16_t txrepn = u->txrepn;
+   if (txrepn && repo != atomic_load_explicit (&u->repi, memory_order_acquire))
+      s -= u->rep[repo].count - txrepn; // Some of the first repeat already sent
    if (u->txsubbit || u->txbreak)
       s++;                      // Sending a byte
    return s;
 }
 
+void
+softuart_tx_notify (softuart_t * u, uint32_t space)
+{                               // Notify (softuart_notify task) once there is this much tx space, e.g. to read more from a socket
+   if (!u || !u->notify)
+      return;
+   u->txwant = space;
+   if (softuart_tx_space (u) >= (int) space && u->txwant)
+   {                            // Already, e.g. freed before txwant was set
+      u->txwant = 0;
+      xTaskNotifyGive (u->notify);
+   }
+}
+
 void
 softuart_tx_flush (softuart_t * u)
-{                               // Wait for all tx to complete
+{                               // Wait for all tx to complete, woken by the int as each byte is taken, and when drained
    if (!u)
       return;
+   uint8_t waiting = 0;
    while (softuart_tx_waiting (u))
-      usleep (1000);
+   {
+      if (!waiting)
+      {                         // Register as waiting, then check again, as for tx space
+         waiting = 1;
+         atomic_fetch_add (&u->txwaiters, 1);
+         continue;
+      }
+      xSemaphoreTake (u->txsem, portMAX_DELAY);
+   }
+   if (waiting && atomic_fetch_sub (&u->txwaiters, 1) > 1)
+      xSemaphoreGive (u->txsem);        // Drained is given once, so pass it on to anyone else waiting
 }
 
 void
@@ -398,6 +1539,7 @@ softuart_tx_break (softuart_t * u, uint8_t chars)
    if (!u)
       return;
    u->txbreak = chars;
+   tick_wake (u);
 }
 
 int
@@ -405,9 +1547,10 @@ softuart_rx_ready (softuart_t * u)
 {                               // Report how many bytes are available to read (negative means BREAK)
    if (!u)
       return 0;
-   int s = (int) u->rxi - (int) u->rxo;
+   uint16_t rxo = atomic_load_explicit (&u->rxo, memory_order_relaxed);
+   int s = (int) atomic_load_explicit (&u->rxi, memory_order_acquire) - (int) rxo;
    if (s < 0)
-      s += sizeof (u->rxdata);
+      s += u->rxsize;
    if (!s)
       s = -(signed) u->rxbreak; // How many bits of break
    return s;
@@ -427,6 +1570,7 @@ softuart_xon (softuart_t * u)
    if (!u)
       return;
    u->txwait = 0;
+   tick_wake (u);
 }
 
 void
@@ -435,7 +1579,166 @@ softuart_stats (softuart_t * u, softuart_stats_t * s, char clear)
    if (!u)
       return;
    if (s)
+   {
       *s = u->stats;
+      s->baudx100 = u->baudx100;
+      s->rxbaudx100 = (u->rxbyedge && !u->rxhunt ? (100000000 + u->rxbitus / 2) / u->rxbitus : 0);
+      s->meter = u->mn;
+      s->speed = (int64_t) u->mspeed * 10000 / 65536;
+      s->bias = (u->mrisen && u->mfalln ? (int64_t) (u->mfall - u->mrise) * 10000 / 65536 : 0);
+      s->peak = (int64_t) u->mpeak * 10000 / 65536;
+      s->stop = (u->mstopn ? (int64_t) u->mstop * 100 / 65536 : 0);
+   }
    if (clear)
+   {
       memset (&u->stats, 0, sizeof (u->stats));
+      u->mn = u->mrisen = u->mfalln = u->mstopn = 0;    // Meter starts again, e.g. after adjusting the machine
+   }
+}
+
+static uint8_t
+prbs (uint16_t * s, uint8_t bits)
+{                               // PRBS15 (x^15 + x^14 + 1), next character of bits, LSB first as sent. The state is the last 15 bits out
+   uint8_t c = 0;
+   for (int b = 0; b < bits; b++)
+   {
+      uint8_t n = (((*s >> 14) ^ (*s >> 13)) & 1);
+      *s = (((*s << 1) | n) & 0x7FFF);
+      c |= (n << b);
+   }
+   return c;
+}
+
+static uint32_t
+char_us (softuart_t * u)
+{                               // Character time (us)
+   return (uint64_t) u->charsub * 100000000 / u->steps / u->baudx100;
+}
+
+static void
+bist_loop (softuart_t * u, int8_t rx, uint8_t rxinv)
+{                               // Start rx (stopped) on a pin, e.g. the tx pin to read back the pad, and wait for the line to settle
+   gpio_set_direction (u->tx, rx == u->tx ? GPIO_MODE_INPUT_OUTPUT : GPIO_MODE_OUTPUT);
+   u->rx = rx;
+   u->rxinv = rxinv;
+   softuart_start (u);
+   usleep (char_us (u) * 2);    // The switch can look like a start bit, so let that character finish, and discard it
+   uint8_t buf[16];
+   while (softuart_rx_buf (u, buf, sizeof (buf)) > 0);
+}
+
+int
+softuart_bist (softuart_t * u, uint16_t baudx100, uint32_t bytes, char internal, softuart_bist_t * r)
+{                               // Loopback self test, sends PRBS15 out of tx and checks it on rx, blocking, the caller must be the only rx reader
+   // Rx is stopped to change its pin and the baud rate (0 for as is), the line's own rate, stats, meter, and rx tracking are put back after
+   // With internal set the rx reads back the tx pad (GPIO matrix), so this tests the timing but not the wiring
+   // The checker syncs from the first 15 bits received, and again from the received bits after two bad characters in a row (a slip)
+   if (!u || !u->started || !r)
+      return -1;
+   memset (r, 0, sizeof (*r));
+   const uint8_t mask = (1 << u->bits) - 1;
+   const uint8_t txwait = u->txwait;
+   const int8_t rx = u->rx;
+   const uint8_t rxinv = u->rxinv;
+   const uint16_t was = u->baudx100;
+   u->txwait = 0;
+   softuart_tx_flush (u);
+   softuart_stop (u);
+   const softuart_stats_t stats = u->stats;
+   const int32_t meter[] = { u->mspeed, u->mrise, u->mfall, u->mpeak, u->mstop };
+   const uint32_t metern[] = { u->mn, u->mrisen, u->mfalln, u->mstopn };
+   const uint32_t rxbitus = u->rxbitus;
+   const uint8_t rxgood = u->rxgood,
+      rxauto = u->rxauto,
+      rxhunt = u->rxhunt;
+   u->rxauto = u->rxhunt = 0;   // Rate is known
+   set_baud (u, baudx100 ? : was);      // Rx stopped, so applies to rx now, and the meter starts again
+   const uint32_t charus = char_us (u);
+   bist_loop (u, internal ? u->tx : rx, internal ? u->txinv : rxinv);
+   memset (&u->stats, 0, sizeof (u->stats));
+   uint16_t ts = 1,             // Tx PRBS state
+      rs = 0,                   // Rx expected PRBS state
+      rh = 0;                   // Rx last 15 bits received
+   uint8_t sync = (15 + u->bits - 1) / u->bits; // Characters to fill rh
+   uint8_t bad = 0;             // Bad characters in a row
+   uint8_t buf[32];
+   const int64_t start = esp_timer_get_time ();
+   int64_t last = start;        // Last rx, or start
+   while (1)
+   {
+      int space = softuart_tx_space (u);
+      while (r->tx < bytes && space > 0)
+      {
+         int n = bytes - r->tx;
+         if (n > space)
+            n = space;
+         if (n > sizeof (buf))
+            n = sizeof (buf);
+         for (int i = 0; i < n; i++)
+            buf[i] = prbs (&ts, u->bits);
+         softuart_tx_buf (u, buf, n, 1);
+         r->tx += n;
+         space -= n;
+      }
+      const int64_t now = esp_timer_get_time ();
+      int n = softuart_rx_buf (u, buf, sizeof (buf));
+      if (!n)
+      {                         // Done once all sent and nothing more arriving, or nothing arriving at all
+         if (softuart_rx_ready (u) < 0)
+            r->brk = 1;         // Loop open
+         if (now - last > charus * 4 + (r->tx < bytes || softuart_tx_waiting (u) ? 1000000 : 0))
+            break;
+         vTaskDelay (1);
+         continue;
+      }
+      last = now;
+      for (int i = 0; i < n; i++)
+      {
+         const uint8_t c = (buf[i] & mask);
+         uint16_t h = rh;
+         for (int b = 0; b < u->bits; b++)
+            h = (((h << 1) | ((c >> b) & 1)) & 0x7FFF);
+         r->rx++;
+         if (sync)
+         {
+            sync--;
+            rs = h;
+         } else
+         {
+            const uint8_t errs = __builtin_popcount ((c ^ prbs (&rs, u->bits)) & mask);
+            r->bits += u->bits;
+            r->biterr += errs;
+            if (errs * 2 <= u->bits)
+               bad = 0;
+            else if (++bad >= 2)
+            {                   // Lost or extra characters, resync
+               bad = 0;
+               rs = h;
+               r->slips++;
+            }
+         }
+         rh = h;
+      }
+   }
+   r->us = last - start;
+   softuart_stats (u, &r->stats, 0);
+   softuart_stop (u);
+   set_baud (u, was);
+   u->stats = stats;
+   u->mspeed = meter[0];
+   u->mrise = meter[1];
+   u->mfall = meter[2];
+   u->mpeak = meter[3];
+   u->mstop = meter[4];
+   u->mn = metern[0];
+   u->mrisen = metern[1];
+   u->mfalln = metern[2];
+   u->mstopn = metern[3];
+   u->rxbitus = rxbitus;
+   u->rxgood = rxgood;
+   u->rxauto = rxauto;
+   u->rxhunt = rxhunt;
+   bist_loop (u, rx, rxinv);
+   u->txwait = txwait;
+   return 0;
 }
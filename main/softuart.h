@@ -24,24 +24,65 @@ struct softuart_stats_s
    uint32_t rxbad1;
    uint32_t rxbadish1;
    uint32_t rxbadp;
+   uint32_t rxoverrun;          // Rx bytes dropped as rx buffer full
+   uint32_t txhigh;             // Most bytes waiting in tx buffer
+   uint16_t rxhigh;             // Most bytes waiting in rx buffer
+   uint32_t rxedgelost;         // Rx edges dropped as edge buffer full (rxedge)
+   uint16_t baudx100;           // Baud rate x100, as set or from auto-baud
+   uint16_t rxbaudx100;         // Rx baud rate x100 as tracked from the sender (rxedge), 0 if not known
+   uint32_t meter;              // Characters metered (rxedge), the following are running averages
+   int16_t speed;               // Sender speed error (0.01%), positive is fast
+   int16_t bias;                // Bias distortion (0.01% of a bit), positive is marking, i.e. marks long
+   uint16_t peak;               // Peak distortion (0.01% of a bit), largest edge error in each character
+   uint16_t stop;               // Stop length (0.01 bits) when sending continuously, 0 if not seen
 };
 
-// Set up
-softuart_t *softuart_init (int8_t timer, revk_gpio_t tx, revk_gpio_t rx, uint16_t baudx100, uint8_t bits, uint8_t stopx2,
-                           uint8_t linelen, uint16_t crm);
+typedef struct softuart_bist_s softuart_bist_t;
+struct softuart_bist_s
+{                               // Loopback self test result
+   uint32_t tx;                 // Bytes sent
+   uint32_t rx;                 // Bytes received
+   uint32_t bits;               // Bits checked (not the bytes used to sync)
+   uint32_t biterr;             // Bits wrong
+   uint32_t slips;              // Times the checker resynced, i.e. bytes lost or extra
+   uint32_t us;                 // Time from start to last byte received (us)
+   uint8_t brk:1;               // Rx saw a break, i.e. the loop is open
+   softuart_stats_t stats;      // UART stats for the run
+};
+
+// Set up, ports on the same timer share it, only the first can have tx in PSRAM
+softuart_t *softuart_init (int8_t timer, revk_gpio_t tx, revk_gpio_t rx, uint16_t baudx100, uint8_t bits, uint8_t stopx10,
+                           uint8_t steps, uint8_t linelen, uint16_t crm, uint32_t txsize, uint16_t rxsize, char psram,
+                           char edge);
 void softuart_start (softuart_t *);
+void softuart_stop (softuart_t *);      // Stop rx, e.g. to change the rx pin, softuart_start to start again
+void softuart_baud (softuart_t *, uint16_t baudx100);   // Change baud rate
+void softuart_format (softuart_t *, uint8_t bits, uint8_t stopx10);     // Change data bits and stop bits (0 to leave as is)
+void softuart_get_format (softuart_t *, uint16_t * baudx100, uint8_t * bits, uint8_t * stopx10);        // Current baud, bits, stop bits
+void softuart_autobaud (softuart_t *, char on); // Auto-baud on rx (rxedge only) from 45.45/50/56.88/74.2/110
+void softuart_notify (softuart_t *, TaskHandle_t task);  // Notify task (give) on rx byte, rx break start or end, and tx drained
+void softuart_hold (softuart_t *, uint8_t c, uint16_t ms, char all);     // Set hold time after control character (not CR)
+void softuart_pri_block (softuart_t *, uint8_t on, uint8_t off);        // No priority bytes ahead of tx ring between on and off sent
 void *softuart_end (softuart_t *);
 
 void softuart_stats (softuart_t *, softuart_stats_t *, char clear);     // Get (and possibly clear) stats
+int softuart_tx_size (softuart_t *);    // Report the most that can be queued (tx ring size)
 int softuart_tx_space (softuart_t *);   // Report how much space for sending
 int softuart_tx_waiting (softuart_t *); // Report how many bytes still being transmitted including one in process of transmission
+void softuart_tx_notify (softuart_t *, uint32_t space);  // Notify (softuart_notify task) once there is this much tx space
 void softuart_tx_flush (softuart_t *);  // Wait for all tx to complete
 void softuart_tx (softuart_t *, uint8_t b);     // Send byte, blocking
+void softuart_tx_pri (softuart_t *, uint8_t b); // Send byte ahead of the main tx ring (e.g. echo), blocking
+int softuart_tx_buf (softuart_t *, const uint8_t *, int len, char wait);        // Send bytes, returns number queued (all if wait)
+void softuart_tx_rep (softuart_t *, uint8_t b, uint32_t n);     // Send byte n times (e.g. tape leader), blocking
 void softuart_tx_break (softuart_t *, uint8_t chars);   // Send a break (number of chars)
 void softuart_xoff (softuart_t *);      // Stop sending
 void softuart_xon (softuart_t *);       // Start sending
 int softuart_rx_ready (softuart_t *);   // Report how many bytes are available to read (-1 means BREAK)
 uint8_t softuart_rx (softuart_t *);     // Receive byte, blocking
+uint8_t softuart_rx_ts (softuart_t *, int64_t * ts);    // Receive byte, blocking, and time it arrived (us)
+int softuart_rx_buf (softuart_t *, uint8_t *, int len); // Receive available bytes, non blocking, returns number received
+int softuart_bist (softuart_t *, uint16_t baudx100, uint32_t bytes, char internal, softuart_bist_t *); // Loopback self test (internal reads back the tx pad), blocking
 uint8_t pe (uint8_t);           // Parity (even)
 
 #endif
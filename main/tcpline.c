@@ -0,0 +1,122 @@
+// TCP and Hayes +++ escape, shared by the main line (ASR33.c) and the extra lines (ttys.c)
+// Copyright © 2026 Adrian Kennard, Andrews & Arnold Ltd. See LICENCE file for details. GPL 3.0
+// Each line keeps its own sockets and state, these are the parts that work the same on every line
+
+#include "revk.h"
+#include "softuart.h"
+#include "tcpline.h"
+
+static void
+tcp_opts (int s)
+{                               // Options for a new TCP connection
+   int one = 1;
+   if (tcpnodelay)
+      setsockopt (s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof (one));
+}
+
+int
+tcp_listen (uint16_t port, int backlog)
+{                               // Listen on port, IPv6 (and IPv4)
+   int s = socket (AF_INET6, SOCK_STREAM, 0);
+   if (s < 0)
+      return -1;
+   struct sockaddr_storage dest_addr;
+   struct sockaddr_in6 *dest_addr_ip6 = (struct sockaddr_in6 *) &dest_addr;
+   bzero (&dest_addr_ip6->sin6_addr.un, sizeof (dest_addr_ip6->sin6_addr.un));
+   dest_addr_ip6->sin6_family = AF_INET6;
+   dest_addr_ip6->sin6_port = htons (port);
+   if (bind (s, (struct sockaddr *) &dest_addr, sizeof (dest_addr)) || listen (s, backlog))
+   {
+      close (s);
+      return -1;
+   }
+   return s;
+}
+
+int
+tcp_accept (int lsock, char *ip, int iplen)
+{                               // Accept a connection, and its peer address
+   struct sockaddr_storage source_addr;         // Large enough for both IPv4 or IPv6
+   socklen_t addr_len = sizeof (source_addr);
+   *ip = 0;
+   int s = accept (lsock, (struct sockaddr *) &source_addr, &addr_len);
+   if (s < 0)
+      return -1;
+   tcp_opts (s);
+   if (source_addr.ss_family == PF_INET)
+      inet_ntoa_r (((struct sockaddr_in *) &source_addr)->sin_addr, ip, iplen - 1);
+   else if (source_addr.ss_family == PF_INET6)
+      inet6_ntoa_r (((struct sockaddr_in6 *) &source_addr)->sin6_addr, ip, iplen - 1);
+   return s;
+}
+
+int
+tcp_connect (const char *host, uint16_t port, char *target, int targetlen)
+{                               // Connect out, target set to the canonical name if known
+   const struct addrinfo hints = {
+      .ai_family = AF_UNSPEC,
+      .ai_socktype = SOCK_STREAM,
+      .ai_flags = AI_CANONNAME,
+   };
+   char ports[20];
+   sprintf (ports, "%d", port);
+   *target = 0;
+   struct addrinfo *res = NULL;
+   if (getaddrinfo (host, ports, &hints, &res) || !res)
+      return -2;
+   int s = -1;
+   for (struct addrinfo * a = res; a; a = a->ai_next)
+   {
+      s = socket (a->ai_family, a->ai_socktype, a->ai_protocol);
+      if (s < 0)
+         continue;
+      if (!connect (s, a->ai_addr, a->ai_addrlen))
+      {
+         tcp_opts (s);
+         if (res->ai_canonname)
+            snprintf (target, targetlen, "%s", res->ai_canonname);
+         break;
+      }
+      close (s);
+      s = -1;
+   }
+   freeaddrinfo (res);
+   return s;
+}
+
+int
+tcp_send (int s, const uint8_t * buf, int len)
+{                               // Send without blocking, so a stalled peer does not hold up the main loop, what does not fit is dropped
+   int l = send (s, buf, len, MSG_DONTWAIT);
+   if (l < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      l = 0;                    // Full
+   return l;
+}
+
+void
+hayes_rx (uint8_t * hayes, uint8_t byte, char start, int64_t gap)
+{                               // Rx byte (not at the prompt), counts +++ typed after the guard time
+   if (!*hayes)
+   {
+      if (byte == pe ('+') && start && gap > HAYES_GUARD)
+         (*hayes)++;
+   } else if (byte != pe ('+') || *hayes >= 3 || gap > HAYES_GUARD)
+      *hayes = 0;
+   else
+      (*hayes)++;
+}
+
+char
+hayes_escape (uint8_t * hayes, int64_t lastrx, int64_t now)
+{                               // Once the guard time after +++ has passed, the line goes to its command prompt
+   if (*hayes != 3 || now - lastrx <= HAYES_GUARD)
+      return 0;
+   *hayes = HAYES_PROMPT;
+   return 1;
+}
+
+int64_t
+hayes_due (uint8_t hayes, int64_t lastrx)
+{
+   return hayes == 3 ? lastrx + HAYES_GUARD + 1 : 0;
+}
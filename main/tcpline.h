@@ -0,0 +1,12 @@
+// TCP and Hayes +++ escape, shared by the main line and the extra lines
+
+#define	HAYES_GUARD	1000000 // Hayes +++ guard time (us)
+#define	HAYES_PROMPT	4       // Hayes counter once at the command prompt
+
+int tcp_listen (uint16_t port, int backlog);    // Listen socket, -1 if failed
+int tcp_accept (int lsock, char *ip, int iplen);        // Accept, with options set, peer address in ip, -1 if failed
+int tcp_connect (const char *host, uint16_t port, char *target, int targetlen); // Connect, with options set, -1 if failed, -2 if host not found
+int tcp_send (int s, const uint8_t * buf, int len);     // Send without blocking, returns bytes sent (0 if full), -1 if failed
+void hayes_rx (uint8_t * hayes, uint8_t byte, char start, int64_t gap); // Count +++, start if nothing else on the line yet
+char hayes_escape (uint8_t * hayes, int64_t lastrx, int64_t now);       // True once guard time after +++ passed, now at prompt
+int64_t hayes_due (uint8_t hayes, int64_t lastrx);      // When hayes_escape is next needed, 0 if not waiting on guard time
@@ -0,0 +1,343 @@
+// Telnet protocol for the main TCP connection, with RFC 2217 com port control
+// Copyright © 2026 Adrian Kennard, Andrews & Arnold Ltd. See LICENCE file for details. GPL 3.0
+// Expects settings from ASR33.c, and is called from its main loop
+// IAC is parsed out of received data and doubled in sent data, CR NUL is CR both ways unless BINARY, options are only answered when they change, so negotiation cannot loop
+// We offer BINARY, and ECHO and SGA (character at a time) unless linemode, when the client is left to send a line at a time
+// Com port control sets the main line baud, data bits, and stop bits, and sends break, parity is left as none, as the ASR33 even parity is in the 8 data bits
+
+#include "revk.h"
+#include "softuart.h"
+#include "tty.h"
+#include "telnet.h"
+
+#define	BREAKCHARS	10      // Break length (characters) for com port break or IAC BRK
+
+enum
+{                               // Commands
+   SE = 240,
+   NOP,
+   DM,
+   BRK,
+   IP,
+   AO,
+   AYT,
+   EC,
+   EL,
+   GA,
+   SB,
+   WILL,
+   WONT,
+   DO,
+   DONT,
+   IAC,
+};
+
+enum
+{                               // Options
+   OPT_BINARY = 0,
+   OPT_ECHO = 1,
+   OPT_SGA = 3,
+   OPT_COMPORT = 44,
+};
+
+enum
+{                               // Com port commands, client to server, server replies add 100
+   CP_SIGNATURE,
+   CP_BAUDRATE,
+   CP_DATASIZE,
+   CP_PARITY,
+   CP_STOPSIZE,
+   CP_CONTROL,
+   CP_NOTIFY_LINESTATE,
+   CP_NOTIFY_MODEMSTATE,
+   CP_FLOW_SUSPEND,
+   CP_FLOW_RESUME,
+   CP_LINESTATE_MASK,
+   CP_MODEMSTATE_MASK,
+   CP_PURGE,
+};
+
+enum
+{                               // Parser states
+   T_DATA,
+   T_IAC,
+   T_OPT,
+   T_SB,
+   T_SBIAC,
+};
+
+static uint8_t
+optbit (uint8_t opt)
+{                               // Bit for an option we handle, 0 if not
+   switch (opt)
+   {
+   case OPT_BINARY:
+      return 1;
+   case OPT_ECHO:
+      return 2;
+   case OPT_SGA:
+      return 4;
+   case OPT_COMPORT:
+      return 8;
+   }
+   return 0;
+}
+
+static uint8_t
+usoffer (void)
+{                               // Options we will do
+   return optbit (OPT_BINARY) | (linemode ? 0 : optbit (OPT_ECHO) | optbit (OPT_SGA));
+}
+
+static uint8_t
+himaccept (void)
+{                               // Options we let the client do
+   return optbit (OPT_BINARY) | optbit (OPT_SGA) | optbit (OPT_COMPORT);
+}
+
+static void
+negotiate (int s, uint8_t cmd, uint8_t opt)
+{
+   uint8_t b[3] = { IAC, cmd, opt };
+   send (s, b, sizeof (b), 0);
+}
+
+static void
+cpreply (int s, uint8_t code, const uint8_t * val, int n)
+{                               // Com port reply
+   uint8_t b[6 + n * 2],
+     p = 0;
+   b[p++] = IAC;
+   b[p++] = SB;
+   b[p++] = OPT_COMPORT;
+   b[p++] = code + 100;
+   p += telnet_escape (NULL, val, n, b + p);
+   b[p++] = IAC;
+   b[p++] = SE;
+   send (s, b, p, 0);
+}
+
+static void
+comport (telnet_t * t, int s, uint8_t code, const uint8_t * d, int n)
+{                               // Com port command, set what we can, and reply with what is now in use
+   uint16_t baudx100;
+   uint8_t bits,
+     stopx10;
+   switch (code)
+   {
+   case CP_SIGNATURE:
+      if (!n)
+      {                         // Request for ours
+         char sig[60];
+         snprintf (sig, sizeof (sig), "%s BUILD %s", revk_app, revk_version);
+         cpreply (s, code, (uint8_t *) sig, strlen (sig));
+      }
+      break;
+   case CP_BAUDRATE:
+      if (n == 4)
+      {
+         uint32_t v = ((uint32_t) d[0] << 24) | (d[1] << 16) | (d[2] << 8) | d[3];
+         if (v && v <= 655)
+            tty_baud (v * 100);
+         tty_get_format (&baudx100, NULL, NULL);
+         v = (baudx100 + 50) / 100;
+         uint8_t r[4] = { v >> 24, v >> 16, v >> 8, v };
+         cpreply (s, code, r, sizeof (r));
+      }
+      break;
+   case CP_DATASIZE:
+      if (n == 1)
+      {
+         if (*d)
+            tty_format (*d, 0);
+         tty_get_format (NULL, &bits, NULL);
+         cpreply (s, code, &bits, 1);
+      }
+      break;
+   case CP_PARITY:
+      if (n == 1)
+      {                         // None, parity is in the data bits
+         uint8_t r = 1;
+         cpreply (s, code, &r, 1);
+      }
+      break;
+   case CP_STOPSIZE:
+      if (n == 1)
+      {
+         if (*d == 1)
+            tty_format (0, 10);
+         else if (*d == 2)
+            tty_format (0, 20);
+         else if (*d == 3)
+            tty_format (0, 15);
+         tty_get_format (NULL, NULL, &stopx10);
+         uint8_t r = (stopx10 <= 12 ? 1 : stopx10 <= 17 ? 3 : 2);
+         cpreply (s, code, &r, 1);
+      }
+      break;
+   case CP_CONTROL:
+      if (n == 1)
+      {
+         uint8_t r = *d;
+         if (r <= 3)
+            r = 1;              // Flow control, none
+         else if (r == 4)
+            r = (t->brk ? 5 : 6);
+         else if (r == 5)
+         {                      // Break on, sent as a break of fixed length
+            t->brk = 1;
+            tty_break (BREAKCHARS);
+         } else if (r == 6)
+            t->brk = 0;
+         else if (r == 7)
+            r = 8;              // DTR, on
+         else if (r == 10)
+            r = 11;             // RTS, on
+         else if (r >= 13 && r <= 19)
+            r = 14;             // Inbound flow control, none
+         cpreply (s, code, &r, 1);
+      }
+      break;
+   case CP_LINESTATE_MASK:
+   case CP_MODEMSTATE_MASK:
+   case CP_PURGE:
+      if (n == 1)
+         cpreply (s, code, d, 1);
+      break;
+   }
+}
+
+void
+telnet_start (telnet_t * t, int s)
+{                               // New connection, offer our options and ask for the client's
+   memset (t, 0, sizeof (*t));
+   t->us = usoffer ();
+   t->him = optbit (OPT_BINARY) | optbit (OPT_SGA);
+   negotiate (s, WILL, OPT_BINARY);
+   negotiate (s, DO, OPT_BINARY);
+   if (t->us & optbit (OPT_SGA))
+      negotiate (s, WILL, OPT_SGA);
+   if (t->us & optbit (OPT_ECHO))
+      negotiate (s, WILL, OPT_ECHO);
+   negotiate (s, DO, OPT_SGA);
+}
+
+int
+telnet_rx (telnet_t * t, int s, uint8_t * buf, int len)
+{                               // Remove telnet commands, and act on them, returns data bytes left in buf
+   int o = 0;
+   for (int i = 0; i < len; i++)
+   {
+      uint8_t c = buf[i];
+      switch (t->state)
+      {
+      case T_DATA:
+         if (c == IAC)
+            t->state = T_IAC;
+         else
+         {
+            if (!c && t->cr && !(t->him & optbit (OPT_BINARY)))
+               t->cr = 0;       // CR NUL is CR
+            else
+            {
+               t->cr = (c == '\r');
+               buf[o++] = c;
+            }
+         }
+         break;
+      case T_IAC:
+         t->state = T_DATA;
+         if (c == IAC)
+         {                      // Escaped 255
+            t->cr = 0;
+            buf[o++] = c;
+         } else if (c >= WILL)
+         {
+            t->cmd = c;
+            t->state = T_OPT;
+         } else if (c == SB)
+         {
+            t->sbn = 0;
+            t->state = T_SB;
+         } else if (c == BRK)
+            tty_break (BREAKCHARS);
+         break;
+      case T_OPT:
+         {
+            t->state = T_DATA;
+            uint8_t b = optbit (c);
+            if (t->cmd == DO)
+            {
+               if (!(b & usoffer ()))
+                  negotiate (s, WONT, c);
+               else if (!(t->us & b))
+               {
+                  t->us |= b;
+                  negotiate (s, WILL, c);
+               }
+            } else if (t->cmd == DONT)
+            {
+               if (t->us & b)
+               {
+                  t->us &= ~b;
+                  negotiate (s, WONT, c);
+               }
+            } else if (t->cmd == WILL)
+            {
+               if (!(b & himaccept ()))
+                  negotiate (s, DONT, c);
+               else if (!(t->him & b))
+               {
+                  t->him |= b;
+                  negotiate (s, DO, c);
+               }
+            } else if (t->cmd == WONT)
+            {
+               if (t->him & b)
+               {
+                  t->him &= ~b;
+                  negotiate (s, DONT, c);
+               }
+            }
+         }
+         break;
+      case T_SB:
+         if (c == IAC)
+            t->state = T_SBIAC;
+         else if (t->sbn < sizeof (t->sb))
+            t->sb[t->sbn++] = c;
+         break;
+      case T_SBIAC:
+         t->state = T_SB;
+         if (c == IAC)
+         {                      // Escaped 255
+            if (t->sbn < sizeof (t->sb))
+               t->sb[t->sbn++] = c;
+         } else if (c == SE)
+         {                      // End of sub negotiation
+            t->state = T_DATA;
+            if (t->sbn >= 2 && t->sb[0] == OPT_COMPORT && (t->him & optbit (OPT_COMPORT)))
+               comport (t, s, t->sb[1], t->sb + 2, t->sbn - 2);
+         } else
+            t->state = T_DATA;  // Broken sub negotiation
+         break;
+      }
+   }
+   return o;
+}
+
+int
+telnet_escape (telnet_t * t, const uint8_t * in, int len, uint8_t * out)
+{                               // Data to send, with IAC doubled, and if t set and we are not BINARY, CR as CR NUL unless CR LF (NVT)
+   char nvt = (t && !(t->us & optbit (OPT_BINARY)));
+   int n = 0;
+   for (int i = 0; i < len; i++)
+   {
+      if (in[i] == IAC)
+         out[n++] = IAC;
+      out[n++] = in[i];
+      if (nvt && (in[i] & 0x7F) == '\r' && (i + 1 == len || (in[i + 1] & 0x7F) != '\n'))
+         out[n++] = 0;
+   }
+   return n;
+}
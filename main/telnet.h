@@ -0,0 +1,20 @@
+// Telnet protocol, with RFC 2217 com port control, for the main TCP connection
+
+#define	TELNET_IAC	255
+
+typedef struct telnet_s telnet_t;
+struct telnet_s
+{
+   uint8_t state;               // Parser state
+   uint8_t cmd;                 // WILL/WONT/DO/DONT whose option is next
+   uint8_t sbn;                 // Sub negotiation bytes
+   uint8_t sb[16];              // Sub negotiation
+   uint8_t us;                  // Options we are doing
+   uint8_t him;                 // Options the client is doing
+   uint8_t cr:1;                // Last data byte received was CR
+   uint8_t brk:1;               // Com port break set on
+};
+
+void telnet_start (telnet_t *, int s);  // New connection, sends our option negotiation
+int telnet_rx (telnet_t *, int s, uint8_t * buf, int len);      // Process received bytes in place, returns data bytes left
+int telnet_escape (telnet_t *, const uint8_t * in, int len, uint8_t * out);      // Data to send, IAC doubled, and CR NUL if not BINARY, out needs 2 x len
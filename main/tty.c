@@ -1,22 +1,75 @@
 // Functions to talk to the TTY
 // Expects globals from ASR33.c
 // This is a wrapper, was for hard and soft UART but now only for soft UART
+// If ita2 is set, tx and rx are translated between ASCII and 5 bit Baudot (ITA2), except tty_tx_raw
 
 #include <driver/gpio.h>
 #include "revk.h"
 #include "softuart.h"
 #include "tty.h"
+#include "ita2.h"
 
 static softuart_t *u = NULL;
+static ita2_t shift = { 0 };    // ITA2 shift states
+static SemaphoreHandle_t ita2_mutex = NULL;     // Tx translate and queue in one go, as shift state is shared
+static void (*tap) (const uint8_t *, int) = NULL;       // Copy of all tx (before ITA2 translation)
 
 void
 tty_setup (void)
 {                               // Does UART setup, expects uart to be set globally, UART number for hard, or negative for soft
-   u = softuart_init (0, tx, rx, baud, databits, stop / 5, linelen, timecr);
+   u = softuart_init (0, tx, rx, baud, databits, stop, oversample, linelen, timecr, txbuf, rxbuf, txpsram, rxedge);
+   ita2_reset (&shift);
+   if (!ita2_mutex)
+      ita2_mutex = xSemaphoreCreateMutex ();
    if (!u)
       ESP_LOGE ("TTY", "Failed to init soft uart");
    else
+   {
+      softuart_hold (u, '\n', timelf, 0);
+      softuart_hold (u, '\a', timebel, 0);
+      softuart_hold (u, '\t', timetab, 0);
+      softuart_hold (u, 0x12, timedc2, 1);      // DC2 engages the punch, so hold everything
+      softuart_pri_block (u, 0x12, 0x14);       // And echo is not punched in the middle of a tape being sent, until DC4
+      if (autobaud)
+         softuart_autobaud (u, 1);
       softuart_start (u);
+   }
+}
+
+void
+tty_notify (TaskHandle_t task)
+{                               // Task to notify on rx, break, and tx drained
+   softuart_notify (u, task);
+}
+
+void
+tty_tx_notify (int space)
+{                               // Notify (tty_notify task) once there is this much tx space
+   softuart_tx_notify (u, space);
+}
+
+void
+tty_baud (uint16_t baudx100)
+{                               // Change baud rate
+   softuart_baud (u, baudx100);
+}
+
+void
+tty_format (uint8_t bits, uint8_t stopx10)
+{                               // Change data bits and stop bits, 0 to leave as is
+   softuart_format (u, bits, stopx10);
+}
+
+void
+tty_get_format (uint16_t * baudx100, uint8_t * bits, uint8_t * stopx10)
+{                               // Current baud rate, data bits, and stop bits
+   softuart_get_format (u, baudx100, bits, stopx10);
+}
+
+int
+tty_bist (uint16_t baudx100, uint32_t bytes, char internal, softuart_bist_t * r)
+{                               // Loopback self test at a baud rate (0 for as is), raw (not ITA2), blocking, nothing else may use the line meanwhile
+   return softuart_bist (u, baudx100, bytes, internal, r);
 }
 
 void
@@ -38,16 +91,138 @@ tty_break (uint8_t chars)
    softuart_tx_break (u, chars);
 }
 
+void
+tty_tx_tap (void (*f) (const uint8_t *, int))
+{                               // Function called with all bytes sent, whichever tx function, e.g. to copy to monitors
+   tap = f;
+}
+
 void
 tty_tx (uint8_t b)
 {                               // Send a byte, blocking
-   softuart_tx (u, b);
+   if (ita2)
+      tty_tx_buf (&b, 1, 1);
+   else
+   {
+      softuart_tx (u, b);
+      if (tap)
+         tap (&b, 1);
+   }
+}
+
+void
+tty_tx_pri (uint8_t b)
+{                               // Send a byte ahead of bulk data, e.g. echo, blocking
+   if (ita2)
+      tty_tx_buf (&b, 1, 1);    // Not with ITA2, as the shift state would be wrong for bytes either side
+   else
+   {
+      softuart_tx_pri (u, b);
+      if (tap)
+         tap (&b, 1);
+   }
+}
+
+int
+tty_tx_buf (const uint8_t * buf, int len, char wait)
+{                               // Send bytes, returns how many queued, all of them if wait set
+   if (!ita2)
+      return tty_tx_raw (buf, len, wait);
+   xSemaphoreTake (ita2_mutex, portMAX_DELAY);
+   int done = 0;
+   while (done < len)
+   {                            // Translate in chunks, each byte is at most a shift and a code
+      uint8_t code[64];
+      int i = done,
+         n = 0;
+      ita2_t was = shift;
+      while (i < len && n <= sizeof (code) - 2)
+         n += ita2_encode (&shift, buf[i++], code + n);
+      if (!wait && softuart_tx_space (u) < n)
+      {                         // Not all room, so none of this chunk, and shift state as it was
+         shift = was;
+         break;
+      }
+      softuart_tx_buf (u, code, n, 1);
+      if (tap)
+         tap (buf + done, i - done);
+      done = i;
+   }
+   xSemaphoreGive (ita2_mutex);
+   return done;
+}
+
+void
+tty_tx_rep (uint8_t b, uint32_t n)
+{                               // Send byte n times with no ITA2 translation, e.g. NUL (blank) tape leader, blocking
+   softuart_tx_rep (u, b, n);
+   if (tap)
+   {
+      uint8_t buf[64];
+      memset (buf, b, sizeof (buf));
+      while (n)
+      {
+         int l = (n > sizeof (buf) ? sizeof (buf) : n);
+         tap (buf, l);
+         n -= l;
+      }
+   }
+}
+
+int
+tty_tx_raw (const uint8_t * buf, int len, char wait)
+{                               // Send bytes with no ITA2 translation, e.g. punched tape data
+   int done = softuart_tx_buf (u, buf, len, wait);
+   if (tap && done)
+      tap (buf, done);
+   return done;
 }
 
 uint8_t
 tty_rx (void)
 {                               // Receive a byte, blocking
-   return softuart_rx (u);      // Soft UART
+   int b;
+   while ((b = tty_rx_ts (NULL)) < 0);  // Past ITA2 shifts
+   return b;
+}
+
+int
+tty_rx_ts (int64_t * ts)
+{                               // Receive a byte, blocking, and the time it arrived (us, esp_timer_get_time) if ts not NULL
+   // Returns -1 if there were only ITA2 shifts waiting, so nothing typed
+   if (!ita2)
+      return softuart_rx_ts (u, ts);    // Soft UART
+   uint8_t b;
+   do
+      b = ita2_decode (&shift, softuart_rx_ts (u, ts));
+   while (!b && softuart_rx_ready (u) > 0);     // Skip shifts
+   if (!b)
+      return -1;                // Nothing after a shift
+   return pe (b);               // Even parity, as expected of an ASR33
+}
+
+int
+tty_rx_buf (uint8_t * buf, int len)
+{                               // Receive available bytes, non blocking
+   int n = softuart_rx_buf (u, buf, len);
+   if (ita2)
+   {                            // Decode in place, dropping shifts
+      int o = 0;
+      for (int i = 0; i < n; i++)
+      {
+         uint8_t c = ita2_decode (&shift, buf[i]);
+         if (c)
+            buf[o++] = pe (c);
+      }
+      n = o;
+   }
+   return n;
+}
+
+int
+tty_tx_size (void)
+{                               // Tx ring size, as actually allocated
+   return softuart_tx_size (u);
 }
 
 int
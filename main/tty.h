@@ -2,10 +2,24 @@
 
 void tty_setup (void);
 void tty_flush (void);
+void tty_notify (TaskHandle_t task);
+void tty_tx_notify (int space);
+void tty_baud (uint16_t baudx100);
+void tty_format (uint8_t bits, uint8_t stopx10);
+void tty_get_format (uint16_t * baudx100, uint8_t * bits, uint8_t * stopx10);
+int tty_bist (uint16_t baudx100, uint32_t bytes, char internal, softuart_bist_t *);
 int tty_rx_ready (void);
+void tty_tx_tap (void (*) (const uint8_t *, int));
 void tty_tx (uint8_t b);
+void tty_tx_pri (uint8_t b);
+int tty_tx_buf (const uint8_t *, int len, char wait);
+int tty_tx_raw (const uint8_t *, int len, char wait);
+void tty_tx_rep (uint8_t b, uint32_t n);
 void tty_break (uint8_t chars);
 uint8_t tty_rx (void);
+int tty_rx_ts (int64_t * ts);
+int tty_rx_buf (uint8_t *, int len);
+int tty_tx_size (void);
 int tty_tx_space (void);
 int tty_tx_waiting (void);
 void tty_xoff (void);
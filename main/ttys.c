@@ -0,0 +1,359 @@
+// Extra teletype lines, each a soft UART on the same timer as the main line, bridged to its own TCP port
+// Copyright © 2026 Adrian Kennard, Andrews & Arnold Ltd. See LICENCE file for details. GPL 3.0
+// Expects globals from ASR33.c, and is polled from its main loop
+// MQTT commands (on the MQTT task) only queue tx without waiting, or set flags for the main loop, which owns the sockets
+// Each line has its own MQTT sub topic (ttyN/...), local echo, and Hayes +++ escape to a prompt to connect out
+// The main line (tty.c) has power and motor control, answerback, big lettering, ITA2, and the game, these are plain lines
+
+#include "revk.h"
+#include <driver/gpio.h>
+#include "softuart.h"
+#include "ttys.h"
+#include "tcpline.h"
+
+#define	TTYS		3       // Extra lines (settings arrays)
+#define	TTYTXBUF	4096    // Tx buffer (internal RAM, as the timer interrupt is shared with the main line)
+#define	MAXLINE		80      // Rx line max
+#define	MAXTCP		64      // TCP recv block max, and tx space needed to read from TCP
+
+extern jo_t jo_uartstats (softuart_stats_t *, uint16_t setbaud);        // From ASR33.c
+
+typedef struct ttyline_s ttyline_t;
+struct ttyline_s
+{
+   softuart_t *u;               // Soft UART, NULL if line not set up
+   int lsock;                   // Listen socket
+   int csock;                   // Connected socket
+   int64_t lastrx;              // Time of last rx byte (us)
+   char line[MAXLINE + 1];      // Rx line buffer
+   uint8_t rxp;                 // Rx line buffer pointer
+   uint8_t hayes;               // Hayes +++ counter, 4 is command prompt
+   uint8_t n;                   // Line number (1 to TTYS)
+   uint8_t echo;                // Local echo when not connected (set by command)
+   volatile uint8_t doclose;    // Close TCP connection (set by command)
+   uint8_t brk:1;               // Break condition
+};
+static ttyline_t ttys[TTYS] = { 0 };
+
+static void
+tevent (ttyline_t * t, const char *suffix, jo_t * jp)
+{                               // Event on the line's sub topic
+   char tag[20];
+   sprintf (tag, "tty%d/%s", t->n, suffix);
+   revk_event (tag, jp);
+}
+
+static char
+tsend (ttyline_t * t, const char *c, char wait)
+{                               // Text to the line, \n as CR LF, even parity, if not wait then only if all fits, returns 0 if not
+   if (!wait)
+   {
+      int len = 0;
+      for (const char *p = c; *p; p++)
+         len += (*p == '\n' ? 2 : 1);
+      if (softuart_tx_space (t->u) < len)
+         return 0;
+   }
+   uint8_t buf[64];
+   int n = 0;
+   while (*c)
+   {
+      if (*c == '\n')
+         buf[n++] = pe ('\r');
+      buf[n++] = pe (*c);
+      c++;
+      if (n >= sizeof (buf) - 1 || !*c)
+      {
+         if (softuart_tx_buf (t->u, buf, n, wait) < n)
+            return 0;
+         n = 0;
+      }
+   }
+   return 1;
+}
+
+static void
+tclose (ttyline_t * t, const char *reason)
+{
+   if (t->csock < 0)
+      return;
+   close (t->csock);
+   t->csock = -1;
+   jo_t j = jo_object_alloc ();
+   jo_string (j, "reason", reason);
+   tevent (t, "closed", &j);
+}
+
+static void
+tconnect (ttyline_t * t, const char *host)
+{                               // Connect out, to the line's TCP port (or the main one)
+   char target[100];
+   int s = tcp_connect (host, ttyport[t->n - 1] ? : port, target, sizeof (target));
+   if (s < 0)
+      return;
+   t->csock = s;
+   jo_t j = jo_object_alloc ();
+   if (*target)
+      jo_string (j, "target", target);
+   tevent (t, "connect", &j);
+}
+
+static char
+readable (int s)
+{                               // Socket has data (or a connection, or has closed), not blocking
+   fd_set r;
+   FD_ZERO (&r);
+   FD_SET (s, &r);
+   struct timeval timeout = { };
+   return select (s + 1, &r, NULL, NULL, &timeout) > 0;
+}
+
+void
+ttys_setup (void)
+{                               // Extra lines, after tty_setup, so on the same timer as the main line
+   for (int i = 0; i < TTYS; i++)
+   {
+      ttyline_t *t = &ttys[i];
+      t->n = i + 1;
+      t->lsock = t->csock = -1;
+      t->echo = !noecho;
+      if (!ttytx[i].set || !ttyrx[i].set)
+         continue;
+      t->u = softuart_init (0, ttytx[i], ttyrx[i], ttybaud[i] ? : baud, ttydatabits[i] ? : databits, ttystop[i] ? : stop,
+                            oversample, linelen, timecr, TTYTXBUF, rxbuf, 0, rxedge);
+      if (!t->u)
+      {
+         ESP_LOGE ("TTY", "Failed to init soft uart for extra line %d", t->n);
+         continue;
+      }
+      softuart_hold (t->u, '\n', timelf, 0);
+      softuart_hold (t->u, '\a', timebel, 0);
+      softuart_hold (t->u, '\t', timetab, 0);
+      if (autobaud)
+         softuart_autobaud (t->u, 1);
+      softuart_start (t->u);
+      softuart_xon (t->u);
+      if (ttyport[i])
+         t->lsock = tcp_listen (ttyport[i], 1);
+   }
+}
+
+static void
+trx (ttyline_t * t, uint8_t byte, int64_t gap)
+{                               // Rx byte, not connected
+   if (t->hayes > 3)
+   {                            // Command prompt
+      if (byte == pe ('\r') || byte == pe ('\n'))
+      {
+         tsend (t, "\n", 1);
+         t->line[t->rxp] = 0;
+         t->hayes = 0;
+         t->rxp = 0;
+         if (!*t->line)
+            tsend (t, "OK\n", 1);
+         else
+         {
+            tconnect (t, t->line);
+            tsend (t, t->csock < 0 ? "+++ COULD NOT CONNECT +++\n" : "+++ CONNECTED +++\n", 1);
+         }
+      } else if ((byte & 0x7F) >= ' ' && t->rxp < MAXLINE)
+      {
+         softuart_tx_pri (t->u, byte);  // Echo
+         t->line[t->rxp++] = (byte & 0x7F);
+      }
+      return;
+   }
+   hayes_rx (&t->hayes, byte, !t->rxp, gap);
+   jo_t j = jo_object_alloc ();
+   jo_int (j, "byte", byte);
+   tevent (t, "rx", &j);
+   if ((byte & 0x7F) == '\n' || (byte & 0x7F) == '\r')
+   {
+      j = jo_create_alloc ();
+      jo_stringn (j, NULL, (void *) t->line, t->rxp);
+      tevent (t, "line", &j);
+      t->rxp = 0;
+   } else if ((byte & 0x7F) >= ' ' && t->rxp < MAXLINE)
+      t->line[t->rxp++] = (byte & 0x7F);
+   if (t->echo)
+      softuart_tx_pri (t->u, byte);
+}
+
+void
+ttys_notify (TaskHandle_t task)
+{                               // Task to notify on rx, break, and tx drained, for each line
+   for (int i = 0; i < TTYS; i++)
+      softuart_notify (ttys[i].u, task);
+}
+
+int
+ttys_fds (fd_set * r, int max)
+{                               // Add sockets to wait on to r, returns max fd
+   for (int i = 0; i < TTYS; i++)
+   {
+      ttyline_t *t = &ttys[i];
+      if (!t->u)
+         continue;
+      int s = (t->csock < 0 ? t->lsock : -1);
+      if (t->csock >= 0 && softuart_tx_space (t->u) >= MAXTCP)
+         s = t->csock;
+      else if (t->csock >= 0)
+         softuart_tx_notify (t->u, MAXTCP);     // Backpressure, as the main line
+      if (s < 0)
+         continue;
+      FD_SET (s, r);
+      if (s > max)
+         max = s;
+   }
+   return max;
+}
+
+int64_t
+ttys_poll (void)
+{                               // Called from main loop, does not block except to queue tx from TCP, returns when next needed (us), 0 if no need
+   int64_t next = 0;
+   void due (int64_t when)
+   {
+      if (!next || when < next)
+         next = when;
+   }
+   for (int i = 0; i < TTYS; i++)
+   {
+      ttyline_t *t = &ttys[i];
+      if (!t->u)
+         continue;
+      if (t->doclose)
+      {                         // By command
+         t->doclose = 0;
+         tclose (t, "command");
+      }
+      if (t->lsock >= 0 && t->csock < 0 && readable (t->lsock))
+      {                         // Incoming connection
+         char addr_str[40];
+         t->csock = tcp_accept (t->lsock, addr_str, sizeof (addr_str));
+         if (t->csock >= 0)
+         {
+            jo_t j = jo_object_alloc ();
+            jo_string (j, "ip", addr_str);
+            tevent (t, "connect", &j);
+            t->hayes = 0;
+         }
+      }
+      if (t->csock >= 0 && softuart_tx_space (t->u) >= MAXTCP && readable (t->csock))
+      {                         // TCP to line, only once there is space, the rest waits in the socket
+         uint8_t buf[MAXTCP];
+         int len = recv (t->csock, buf, sizeof (buf), 0);
+         if (len <= 0)
+            tclose (t, "close");
+         else
+            softuart_tx_buf (t->u, buf, len, 1);
+      }
+      if (hayes_escape (&t->hayes, t->lastrx, esp_timer_get_time ()))
+      {                         // End of Hayes +++ escape sequence, command prompt
+         char temp[60];
+         t->rxp = 0;
+         sprintf (temp, "\nLINE %d", t->n);
+         tsend (t, temp, 1);
+         if (ttyport[i])
+         {
+            sprintf (temp, " LISTENING ON TCP PORT %d", ttyport[i]);
+            tsend (t, temp, 1);
+         }
+         tsend (t, "\nENTER IP/DOMAIN TO MAKE CONNECTION\n> ", 1);
+      } else if (hayes_due (t->hayes, t->lastrx))
+         due (hayes_due (t->hayes, t->lastrx)); // Hayes guard time
+      int len = softuart_rx_ready (t->u);
+      if (len < 0)
+      {                         // Break
+         if (!t->brk)
+         {
+            t->brk = 1;
+            t->hayes = 0;
+            t->rxp = 0;
+            tclose (t, "break");
+         }
+         continue;
+      }
+      t->brk = 0;
+      if (!len)
+         continue;
+      if (t->csock >= 0)
+      {                         // Connected, line to TCP
+         uint8_t buf[64];
+         len = softuart_rx_buf (t->u, buf, sizeof (buf));
+         if (len > 0 && tcp_send (t->csock, buf, len) < 0)
+            tclose (t, "error");
+         t->lastrx = esp_timer_get_time ();
+         if (softuart_rx_ready (t->u) > 0)
+            due (t->lastrx);    // More to do
+         continue;
+      }
+      while (len-- > 0)
+      {
+         int64_t rxt;
+         uint8_t byte = softuart_rx_ts (t->u, &rxt);
+         trx (t, byte, rxt - t->lastrx);
+         t->lastrx = rxt;
+      }
+      if (hayes_due (t->hayes, t->lastrx))
+         due (hayes_due (t->hayes, t->lastrx)); // Hayes guard time
+   }
+   return next;
+}
+
+const char *
+ttys_command (const char *suffix, jo_t j)
+{                               // MQTT command on an extra line's sub topic, ttyN/..., NULL if not one
+   if (strncmp (suffix, "tty", 3) || suffix[3] < '1' || suffix[3] >= '1' + TTYS || suffix[4] != '/')
+      return NULL;
+   ttyline_t *t = &ttys[suffix[3] - '1'];
+   suffix += 5;
+   if (!t->u)
+      return "Extra line not set up";
+   if (!strcmp (suffix, "text") || !strcmp (suffix, "line"))
+   {                            // Plain text, JSON string
+      char *text = jo_strdup (j);
+      if (!text)
+         return "JSON string expected";
+      char ok = tsend (t, text, 0);
+      if (ok && !strcmp (suffix, "line"))
+         ok = tsend (t, "\n", 0);
+      free (text);
+      if (!ok)
+         return "Tx buffer full";
+   } else if (!strcmp (suffix, "tx"))
+   {                            // Raw bytes, JSON string
+      int len = jo_strncpy (j, NULL, 0);
+      if (len < 0)
+         return "Expecting JSON string";
+      uint8_t *buf = malloc (len);
+      if (!buf)
+         return "Malloc";
+      jo_strncpy (j, buf, len);
+      int done = (softuart_tx_space (t->u) < len ? 0 : softuart_tx_buf (t->u, buf, len, 0));
+      free (buf);
+      if (done < len)
+         return "Tx buffer full";
+   } else if (!strcmp (suffix, "break"))
+   {
+      int chars = 10;
+      if (j && jo_here (j) == JO_NUMBER)
+         chars = jo_read_int (j);
+      softuart_tx_break (t->u, chars);
+   } else if (!strcmp (suffix, "echo"))
+      t->echo = 1;
+   else if (!strcmp (suffix, "noecho"))
+      t->echo = 0;
+   else if (!strcmp (suffix, "close"))
+      t->doclose = 1;           // Main loop closes it, as it may be using the socket
+   else if (!strcmp (suffix, "uartstats"))
+   {
+      softuart_stats_t s;
+      softuart_stats (t->u, &s, 1);
+      jo_t j = jo_uartstats (&s, ttybaud[t->n - 1] ? : baud);
+      char tag[20];
+      sprintf (tag, "tty%d/uartstats", t->n);
+      revk_info (tag, &j);
+   }
+   return "";
+}
@@ -0,0 +1,7 @@
+// Extra teletype lines
+
+void ttys_setup (void);
+void ttys_notify (TaskHandle_t task);
+int ttys_fds (fd_set *, int max);
+int64_t ttys_poll (void);
+const char *ttys_command (const char *suffix, jo_t j);
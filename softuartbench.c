@@ -0,0 +1,437 @@
+// Host side benchmark for the soft UART timer interrupt
+// Copyright © 2026 Adrian Kennard, Andrews & Arnold Ltd. See LICENCE file for details. GPL 3.0
+//
+// This builds main/softuart.c on the host with the GPIO registers replaced by a simulated register file.
+// The Tx pin is looped back to the Rx pin, random data is queued, and the timer interrupt handler is called for millions of ticks.
+// Reports ns per tick and the worst case tick, and checks every byte sent comes back.
+// With --edge the rx edge interrupt is called on each change of the simulated line, and the decoder run between batches.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <popt.h>
+#include <time.h>
+#include <err.h>
+#include <math.h>
+
+int debug = 0;
+
+// Simulated ESP32 environment for softuart.c
+#define	SOFTUART_BENCH
+#define	IRAM_ATTR
+#define	APB_CLK_FREQ	80000000
+#define	ESP_LOGE(tag,...)	warnx(__VA_ARGS__)
+#define	GPIO_IS_VALID_GPIO(n)		((n) < 49)
+#define	GPIO_IS_VALID_OUTPUT_GPIO(n)	((n) < 49)
+#define	MALLOC_CAP_INTERNAL	0
+#define	heap_caps_malloc(s,c)	malloc(s)
+#define	heap_caps_free(p)	free(p)
+
+typedef struct revk_gpio_s revk_gpio_t;
+struct revk_gpio_s
+{
+   uint16_t num:10;
+   uint16_t strong:1;
+   uint16_t weak:1;
+   uint16_t pulldown:1;
+   uint16_t nopull:1;
+   uint16_t invert:1;
+   uint16_t set:1;
+};
+
+static void
+revk_gpio_output (revk_gpio_t g, uint8_t v)
+{
+}
+
+static void
+revk_gpio_input (revk_gpio_t g)
+{
+}
+
+typedef void *SemaphoreHandle_t;
+typedef int BaseType_t;
+#define	pdFALSE	0
+#define	pdTRUE	1
+#define	portMAX_DELAY	0
+#define	xSemaphoreCreateBinary()	((void*)1)
+#define	xSemaphoreTake(s,t)	do{}while(0)
+#define	xSemaphoreGive(s)	do{}while(0)
+#define	xSemaphoreGiveFromISR(s,w)	do{*(w)=pdTRUE;}while(0)
+#define	vSemaphoreDelete(s)
+typedef void *TaskHandle_t;
+#define	pdMS_TO_TICKS(ms)	(ms)
+#define	xTaskCreate(f,n,s,a,p,h)
+#define	vTaskDelete(h)
+#define	vTaskDelay(t)
+#define	taskYIELD()
+#define	ulTaskNotifyTake(c,t)	do{(void)(t);}while(0)
+#define	vTaskNotifyGiveFromISR(t,w)
+#define	xTaskNotifyGive(t)
+#define	portYIELD_FROM_ISR()
+
+// Simulated time, from the timer counts (at APB_CLK_FREQ/2) of each tick run, as set by the timer alarm
+static uint64_t simcount = 0;
+static uint32_t simalarm = 0;
+#define	esp_timer_get_time()	((int64_t)(simcount * 2000000 / APB_CLK_FREQ))
+
+// Timer driver - the benchmark calls the interrupt handler directly so these do nothing
+typedef struct
+{
+   int divider,
+     counter_dir,
+     counter_en,
+     alarm_en,
+     intr_type,
+     auto_reload,
+     clk_src;
+} timer_config_t;
+enum
+{ TIMER_COUNT_UP, TIMER_PAUSE, TIMER_START, TIMER_ALARM_EN, TIMER_INTR_LEVEL, TIMER_SRC_CLK_DEFAULT };
+#define	ESP_INTR_FLAG_LOWMED	0
+#define	ESP_INTR_FLAG_IRAM	0
+#define	timer_init(g,t,c)
+#define	timer_set_counter_value(g,t,v)
+#define	timer_set_alarm_value(g,t,v)	do{simalarm=(v);}while(0)
+#define	timer_isr_callback_add(g,t,f,a,l)
+#define	timer_enable_intr(g,t)
+#define	timer_disable_intr(g,t)
+#define	timer_isr_callback_remove(g,t)
+#define	timer_start(g,t)
+// Pausing the timer stops the benchmark calling the interrupt, until restarted
+static int simrun = 1;
+#define	timer_group_get_counter_value_in_isr(g,t)	0
+#define	timer_group_set_alarm_value_in_isr(g,t,v)	do{simalarm=(v);}while(0)
+#define	timer_group_set_counter_enable_in_isr(g,t,e)	do{simrun=((e)==TIMER_START);}while(0)
+typedef int portMUX_TYPE;
+#define	portMUX_INITIALIZE(m)
+#define	portENTER_CRITICAL(m)
+#define	portEXIT_CRITICAL(m)
+#define	portENTER_CRITICAL_ISR(m)
+#define	portEXIT_CRITICAL_ISR(m)
+#define	portENTER_CRITICAL_SAFE(m)
+#define	portEXIT_CRITICAL_SAFE(m)
+enum
+{ GPIO_INTR_DISABLE, GPIO_INTR_POSEDGE, GPIO_INTR_NEGEDGE, GPIO_INTR_ANYEDGE };
+enum
+{ GPIO_MODE_OUTPUT, GPIO_MODE_INPUT_OUTPUT };
+#define	gpio_install_isr_service(f)
+#define	gpio_set_intr_type(g,t)
+#define	gpio_isr_handler_add(g,f,a)
+#define	gpio_isr_handler_remove(g)
+#define	gpio_set_direction(g,m)
+
+// Simulated GPIO register file, same two bank layout as the ESP32
+static volatile uint32_t gpio_out[2];
+static volatile uint32_t gpio_in[2];
+#define gpio_set(r) do{if ((r) >= 32)gpio_out[1] |= 1 << ((r) - 32); else if ((r) >= 0)gpio_out[0] |= 1 << (r);}while(0)
+#define gpio_clr(r) do{if ((r) >= 32)gpio_out[1] &= ~(1 << ((r) - 32));else if ((r) >= 0)gpio_out[0] &= ~(1 << (r));}while(0)
+#define gpio_get(r) (((r) >= 32)?((gpio_in[1] >> ((r) - 32)) & 1):((r) >= 0)?((gpio_in[0] >> (r)) & 1):0)
+
+#include "main/softuart.h"
+#include "main/softuart.c"
+
+static inline uint64_t
+now_ns (void)
+{
+   struct timespec t;
+   clock_gettime (CLOCK_MONOTONIC, &t);
+   return (uint64_t) t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+int
+main (int argc, const char *argv[])
+{
+   long ticks = 10000000;
+   double baud = 110;
+   double txbaud = 0;
+   double baud2 = 0;
+   double bias = 0;
+   int autob = 0;
+   int bits = 8;
+   int stop = 20;
+   int steps = 5;
+   int linelen = 72;
+   int crms = 200;
+   int idle = 0;
+   int seed = 1;
+   int txpin = 15;
+   int txsize = 32768;
+   int rxsize = 32;
+   int rxpin = 16;
+   int edge = 0;
+   int invert = 0;
+   poptContext optCon;          // context for parsing command-line options
+   {                            // POPT
+      const struct poptOption optionsTable[] = {
+         {"ticks", 'n', POPT_ARG_LONG | POPT_ARGFLAG_SHOW_DEFAULT, &ticks, 0, "Interrupts to run", "N"},
+         {"baud", 'b', POPT_ARG_DOUBLE | POPT_ARGFLAG_SHOW_DEFAULT, &baud, 0, "Baud rate", "N"},
+         {"baud2", 0, POPT_ARG_DOUBLE, &baud2, 0, "Second port on the same timer at this baud rate, looped back on Tx+2/Rx+2", "N"},
+         {"txbaud", 0, POPT_ARG_DOUBLE, &txbaud, 0, "Tx (so sender) baud rate, if not same as rx (rxedge)", "N"},
+         {"bias", 0, POPT_ARG_DOUBLE, &bias, 0, "Marking bias, rx rising edges early by this % of a bit (rxedge)", "N"},
+         {"autobaud", 'a', POPT_ARG_NONE, &autob, 0, "Auto-baud (rxedge)"},
+         {"bits", 0, POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT, &bits, 0, "Data bits", "N"},
+         {"stop", 0, POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT, &stop, 0, "Stop bits x10", "N"},
+         {"steps", 's', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT, &steps, 0, "Interrupts per bit (5, 8, 16)", "N"},
+         {"linelen", 0, POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT, &linelen, 0, "Line length", "N"},
+         {"crms", 0, POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT, &crms, 0, "CR time (ms)", "N"},
+         {"idle", 'i', POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT, &idle, 0, "Percentage of time tx left idle", "N"},
+         {"seed", 0, POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT, &seed, 0, "Random seed", "N"},
+         {"tx", 0, POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT, &txpin, 0, "Tx GPIO (>=32 uses second bank)", "N"},
+         {"rx", 0, POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT, &rxpin, 0, "Rx GPIO (>=32 uses second bank)", "N"},
+         {"txsize", 0, POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT, &txsize, 0, "Tx ring size", "N"},
+         {"rxsize", 0, POPT_ARG_INT | POPT_ARGFLAG_SHOW_DEFAULT, &rxsize, 0, "Rx ring size", "N"},
+         {"edge", 'e', POPT_ARG_NONE, &edge, 0, "Rx by edge interrupt and decoder"},
+         {"invert", 0, POPT_ARG_NONE, &invert, 0, "Tx and Rx inverted"},
+         {"debug", 'v', POPT_ARG_NONE, &debug, 0, "Debug"},
+         POPT_AUTOHELP {}
+      };
+
+      optCon = poptGetContext (NULL, argc, argv, optionsTable, 0);
+
+      int c;
+      if ((c = poptGetNextOpt (optCon)) < -1)
+         errx (1, "%s: %s\n", poptBadOption (optCon, POPT_BADOPTION_NOALIAS), poptStrerror (c));
+   }
+   poptFreeContext (optCon);
+   if (ticks <= 0 || baud <= 0 || bits < 1 || bits > 8 || txpin == rxpin || txpin >= 49 || rxpin >= 49 || txsize < 2
+       || rxsize < 2 || rxsize > 65535 || (baud2 > 0 && (txpin + 2 >= 49 || rxpin + 2 >= 49 || txpin + 2 == rxpin || rxpin + 2 == txpin)))
+      errx (1, "Bad parameters");
+
+   srandom (seed);
+   struct
+   {                            // Each port is looped back, and checked against what it sent
+      softuart_t *u;
+      int txpin,
+        rxpin;
+      double baud;              // Sender baud rate
+      uint8_t *q;               // Expected rx, i.e. what we queued for tx, in order
+      uint32_t qi,
+        qo,
+        bad,
+        badts,
+        lost;
+      int64_t lastts;
+      uint8_t synced;
+      uint8_t txon;
+   } port[2] = { 0 };
+   int ports = (baud2 > 0 ? 2 : 1);
+   uint32_t qsize = 1 << 20;
+   for (int p = 0; p < ports; p++)
+   {
+      port[p].txpin = txpin + p * 2;
+      port[p].rxpin = rxpin + p * 2;
+      port[p].baud = (p ? baud2 : baud);
+      revk_gpio_t tx = {.num = port[p].txpin,.set = 1,.invert = invert };
+      revk_gpio_t rx = {.num = port[p].rxpin,.set = 1,.invert = invert };
+      softuart_t *u = port[p].u =
+         softuart_init (0, tx, rx, lround (port[p].baud * 100), bits, stop, steps, linelen, crms, txsize, rxsize, 0, edge);
+      if (!u)
+         errx (1, "softuart_init failed");
+      softuart_start (u);
+      softuart_xon (u);
+      port[p].q = malloc (qsize);
+      port[p].synced = 1;
+      port[p].txon = 1;
+   }
+   softuart_t *u = port[0].u;
+   if (txbaud > 0)
+   {                            // Sender at a different speed, rx still expects baud
+      softuart_baud (u, lround (txbaud * 100));
+      u->rxbitus = u->rxbitnom = lround (1000000 / baud);
+      port[0].baud = txbaud;
+   }
+   if (autob)
+   {
+      softuart_autobaud (u, 1);
+      port[0].synced = 0;
+   }
+   uint8_t mask = (1 << bits) - 1;
+
+   void wire (void)
+   {                            // The loop - Rx input follows Tx output
+      for (int p = 0; p < ports; p++)
+      {
+         int txpin = port[p].txpin,
+            rxpin = port[p].rxpin;
+         uint32_t was = gpio_in[rxpin / 32];
+         if (gpio_out[txpin / 32] & (1 << (txpin % 32)))
+            gpio_in[rxpin / 32] |= (1 << (rxpin % 32));
+         else
+            gpio_in[rxpin / 32] &= ~(1 << (rxpin % 32));
+         if (was != gpio_in[rxpin / 32])
+         {
+            uint8_t mark = (((gpio_in[rxpin / 32] >> (rxpin % 32)) & 1) ^ invert);
+            if (edge && bias && mark)
+            {                   // Rising edge, as if earlier
+               uint64_t early = lround (bias / 100 * APB_CLK_FREQ / 2 / port[p].baud);
+               simcount -= early;
+               edge_isr (port[p].u);
+               simcount += early;
+            } else if (edge)
+               edge_isr (port[p].u);
+            else if (!mark)
+               wake_isr (port[p].u);
+         }
+      }
+   }
+   void traffic (void)
+   {                            // Keep tx fed, and drain and check rx
+      for (int p = 0; p < ports; p++)
+      {
+         softuart_t *u = port[p].u;
+         uint8_t *q = port[p].q;
+         if (edge)
+            softuart_rx_edges (u, esp_timer_get_time ());
+         if (!(random () % 64))
+            port[p].txon = ((random () % 100) >= idle);
+         while (port[p].txon && softuart_tx_space (u) > 0 && port[p].qi - port[p].qo < qsize - 100)
+         {
+            uint8_t b = random () & mask;
+            if (!(random () % 16) && ((u->repi + 1) & (REPS - 1)) != u->repo)
+            {                   // Repeated byte
+               int n = 2 + random () % 50;
+               softuart_tx_rep (u, b, n);
+               while (n--)
+                  q[port[p].qi++ % qsize] = b;
+               continue;
+            }
+            softuart_tx (u, b);
+            q[port[p].qi++ % qsize] = b;
+         }
+         while (softuart_rx_ready (u) > 0)
+         {
+            int64_t ts;
+            uint8_t b = softuart_rx_ts (u, &ts);
+            if (ts < port[p].lastts || ts > esp_timer_get_time ())
+               port[p].badts++; // Timestamps in order and not in the future
+            port[p].lastts = ts;
+            if (!port[p].synced)
+            {                   // First byte after auto-baud lock, find where we are, bytes before it were lost
+               uint32_t o = port[p].qo;
+               while (o != port[p].qi && o - port[p].qo < 64 && q[o % qsize] != b)
+                  o++;
+               if (o == port[p].qi || o - port[p].qo >= 64)
+                  continue;
+               port[p].lost += o - port[p].qo;
+               port[p].qo = o;
+               port[p].synced = 1;
+            }
+            if (port[p].qo == port[p].qi || b != q[port[p].qo++ % qsize])
+            {
+               port[p].bad++;
+               if (debug)
+                  warnx ("Port %d mismatch at byte %u, got %02X expected %02X", p + 1, port[p].qo, b, q[(port[p].qo - 1) % qsize]);
+               for (uint32_t o = port[p].qo; o != port[p].qi && o - port[p].qo < 3; o++)
+                  if (q[o % qsize] == b)
+                  {             // Realign after a lost byte, so one error is not counted for every byte after it
+                     port[p].qo = o + 1;
+                     break;
+                  }
+            }
+         }
+      }
+   }
+
+   wire ();
+   // Throughput - ISR only, in batches between traffic updates
+   uint64_t total = 0;
+   long paused = 0;
+   for (long t = 0; t < ticks; t += 64)
+   {
+      traffic ();
+      uint64_t a = now_ns ();
+      for (int n = 0; n < 64; n++)
+      {
+         if (simrun)
+         {
+            simcount += simalarm;
+            timer_isr (u->t);
+         } else
+         {
+            simcount += u->t->ticks;
+            paused++;
+         }
+         wire ();
+      }
+      total += now_ns () - a;
+   }
+   // Worst case path - each ISR call timed
+   uint64_t overhead = ~0ULL;
+   for (int n = 0; n < 1000; n++)
+   {
+      uint64_t a = now_ns ();
+      uint64_t d = now_ns () - a;
+      if (d < overhead)
+         overhead = d;
+   }
+   uint32_t hist[256] = { 0 };
+   uint64_t worst = 0;
+   long worstat = 0;
+   for (long t = 0; t < ticks; t++)
+   {
+      if (!(t % 64))
+         traffic ();
+      uint64_t a = now_ns ();
+      if (simrun)
+         timer_isr (u->t);
+      uint64_t d = now_ns () - a;
+      simcount += (simrun ? simalarm : u->t->ticks);
+      d = (d > overhead ? d - overhead : 0);
+      wire ();
+      if (d > worst)
+      {
+         worst = d;
+         worstat = t;
+      }
+      hist[d < 255 ? d : 255]++;
+   }
+   traffic ();
+   uint64_t percentile (int per1000)
+   {                            // ns for given percentile, 255 means 255 or more
+      uint64_t p = 0;
+      for (uint64_t c = 0; p < 255 && c + hist[p] < (uint64_t) ticks * per1000 / 1000; c += hist[p++]);
+      return p;
+   }
+
+   softuart_stats_t s = { 0 };
+   softuart_stats (u, &s, 0);
+   double secs = (double) simcount * 2 / APB_CLK_FREQ;
+   printf ("Ticks:     %ld x 2 at %.2f Baud %d bits %.1f stop x%d (%.1f s of line time each)\n", ticks, baud, bits,
+           stop / 10.0, u->steps, secs / 2);
+   printf ("ns/tick:   %.2f (%.1f%% of ticks paused as idle)\n", (double) total / ticks, 100.0 * paused / ticks);
+   printf ("p99/p99.9: %llu/%llu ns\n", (unsigned long long) percentile (990), (unsigned long long) percentile (999));
+   printf ("Worst:     %llu ns (tick %ld, includes any host scheduling)\n", (unsigned long long) worst, worstat);
+   printf ("Tx/Rx:     %u/%u bytes, %u mismatched, %u bad timestamps, %u in flight\n", s.tx, s.rx, port[0].bad, port[0].badts,
+           port[0].qi - port[0].qo);
+   printf ("Rx errors: start %u stop %u zero %u/%u one %u/%u\n", s.rxbadstart, s.rxbadstop, s.rxbad0, s.rxbadish0, s.rxbad1,
+           s.rxbadish1);
+   printf ("Tx rate:   %.4f chars/s (%.4f if no idle or CR waits)\n", s.tx / secs, u->baudx100 / 100.0 / (1 + bits + stop / 10.0));
+   printf ("Buffers:   rx overrun %u, high water tx %u rx %u", s.rxoverrun, s.txhigh, s.rxhigh);
+   if (edge)
+      printf (", edges lost %u", s.rxedgelost);
+   printf ("\n");
+   if (edge)
+      printf ("Meter:     %u chars, speed %+.2f%%, bias %+.2f%%, peak %.2f%%, stop %.2f bits\n", s.meter, s.speed / 100.0,
+              s.bias / 100.0, s.peak / 100.0, s.stop / 100.0);
+   if (edge)
+      printf ("Rx baud:   %.2f tracked, %.2f set%s, %u bytes lost before auto-baud lock\n", s.rxbaudx100 / 100.0,
+              s.baudx100 / 100.0, u->rxhunt ? " (hunting)" : "", port[0].lost);
+   uint32_t bad = 0;
+   for (int p = 0; p < ports; p++)
+   {
+      if (p)
+      {
+         softuart_stats (port[p].u, &s, 0);
+         printf ("Port %d:    %.2f Baud, Tx/Rx %u/%u bytes, %u mismatched, %u bad timestamps, %u in flight\n", p + 1, port[p].baud,
+                 s.tx, s.rx, port[p].bad, port[p].badts, port[p].qi - port[p].qo);
+      }
+      bad += port[p].bad;
+      port[p].u = softuart_end (port[p].u);
+      free (port[p].q);
+   }
+   return bad ? 1 : 0;
+}